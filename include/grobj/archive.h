@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "grobj/dump.h"
+#include "grobj/grimrock.h"
+#include "grobj/tangents.h"
+
+
+// A Grimrock asset archive (.dat), memory mapped.
+//
+//   FourCC     magic;          // "GRA2"
+//   uint32     numEntries;
+//   Entry      entries[numEntries];
+//   ...        file data
+//
+// Entry names are only stored as 32-bit hashes (see asset_name_hash()).
+
+struct ArchiveEntry
+{
+	std::uint32_t nameHash;
+	std::uint32_t offset;          // from the start of the archive
+	std::uint32_t compressedSize;  // 0 if stored uncompressed
+	std::uint32_t size;            // uncompressed size
+
+	inline bool compressed() const { return compressedSize != 0; }
+};
+
+// Hash of an asset path, as stored in ArchiveEntry::nameHash.
+//   Assumed to be 32-bit FNV-1a over the lower-cased path using '/' separators;
+//   if that doesn't match an archive, entries can still be addressed by hash ("#1a2b3c4d").
+std::uint32_t asset_name_hash(std::string_view name);
+
+class Archive
+{
+public:
+	static std::variant<std::string, Archive> open(const std::string &filename);
+
+	Archive(Archive &&other) noexcept;
+	~Archive();
+
+	Archive(const Archive &) = delete;
+	Archive &operator = (const Archive &) = delete;
+	Archive &operator = (Archive &&) = delete;
+
+	inline const std::vector<ArchiveEntry> &entries() const { return _entries; }
+
+	const ArchiveEntry *find(std::uint32_t nameHash) const;
+	const ArchiveEntry *find(std::string_view name) const;  // path, or "#<hex hash>"
+
+	// Contents of an entry, decompressed if needed.
+	//   Stored entries are not copied; 'buffer' is only used for decompressed data.
+	std::variant<std::string, const byte *> data(const ArchiveEntry &entry, std::vector<byte> &buffer) const;
+
+	std::variant<std::string, ModelFile> read_model(const ArchiveEntry &entry) const;
+
+private:
+	Archive() = default;
+
+private:
+	const byte               *_map { nullptr };
+	size_t                    _size { 0 };
+	std::vector<ArchiveEntry> _entries;
+	std::unordered_map<std::uint32_t, size_t> _index;  // nameHash -> _entries[]
+};
+
+
+struct ArchiveOptions
+{
+	std::string              archiveFile;
+	std::vector<std::string> names;          // entries to process; empty = all models
+	bool                     list;           // list entries instead
+	bool                     dump;
+	Filter                   dumpFilter;
+	std::string              outputDir;      // convert models to <outputDir>/<name>.obj
+	bool                     mergeMaterials;
+	bool                     meshlets;       // also write <outputDir>/<name>.meshlets
+	bool                     generateTangents; // before converting
+	NormalWeighting          normalWeighting;
+	size_t                   numThreads;     // 0 = one per hardware thread
+};
+
+// List, dump and/or convert the models of an archive, in parallel.
+int process_archive(const ArchiveOptions &opts);
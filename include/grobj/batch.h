@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "grobj/grimrock.h"
+#include "grobj/model_index.h"
+
+
+// All segments of a model sharing one material, merged into a single draw.
+//   Vertices are in world (model root) space; indices refer to this batch only.
+struct MaterialBatch
+{
+	std::string          material;
+	std::vector<float32> positions;   // xyz per vertex
+	std::vector<float32> normals;     // xyz per vertex, or empty if no source mesh had normals
+	std::vector<float32> texCoords;   // uv per vertex, or empty if no source mesh had uv0
+	std::vector<int32>   indices;     // 3 per triangle
+	size_t               segments { 0 };  // number of source segments merged into this batch
+
+	inline size_t numVertices() const { return positions.size() / 3; }
+};
+
+// Node transforms composed up to the root, indexed as ModelFile::nodes
+std::vector<Mat4x3> world_transforms(const ModelFile &model, const ModelIndex &index);
+
+// Number of draws without batching, i.e. one per mesh segment
+size_t draw_calls(const ModelFile &model);
+
+std::vector<MaterialBatch> batch_by_material(const ModelFile &model);
+
+std::string write_obj(std::string filename, const std::vector<MaterialBatch> &batches);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "grobj/grimrock.h"
+#include "grobj/tangents.h"
+
+
+// Fingerprint of a mesh's contents: vertex arrays, indices and segments.
+//   Equal keys only make two meshes candidates; dedup() confirms a match by comparing
+//   the contents with the first occurrence, re-read from its model file, so a hash
+//   collision yields a second mesh (<hash>-1) rather than a wrong merge.
+struct MeshKey
+{
+	std::uint64_t hash;
+	std::uint64_t bytes;
+};
+
+MeshKey mesh_key(const MeshData &md);
+
+struct DedupOptions
+{
+	std::string     outputDir;         // receives meshes/<id>.obj and manifest.json
+	size_t          numThreads;        // 0 = one per hardware thread
+	bool            generateTangents;  // before hashing, so meshes are compared as written
+	NormalWeighting normalWeighting;
+};
+
+// Read all models, write each distinct mesh once, and a manifest of all mesh instances.
+int dedup(const std::vector<std::string> &filenames, const DedupOptions &opts);
@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "grobj/grimrock.h"
+#include "grobj/model_index.h"
 
 using Filter = std::uint32_t;
 static constexpr Filter includeEmptyNodes  { 1 << 0 };
@@ -11,9 +12,9 @@ static constexpr Filter includeTransforms  { 1 << 2 };
 
 
 void dump(const ModelFile &mf, std::ostream &out, Filter filter);
-void dump(const Node &node, std::ostream &out, Filter filter, size_t index) ;
-void dump(const Bone &bone, std::ostream &out, Filter filter, size_t index);
+void dump(const Node &node, std::ostream &out, Filter filter, size_t index, const ModelIndex &modelIndex);
+void dump(const Bone &bone, std::ostream &out, Filter filter, size_t index, const ModelIndex &modelIndex);
 void dump(const VertexArray &va, std::ostream &out, Filter filter);
 void dump(const MeshSegment &ms, std::ostream &out, Filter filter, size_t index);
 void dump(const MeshData &md, std::ostream &out, Filter filter);
-void dump(const MeshEntity &me, std::ostream &out, Filter filter);
+void dump(const MeshEntity &me, std::ostream &out, Filter filter, const ModelIndex &modelIndex);
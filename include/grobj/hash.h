@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+// 64-bit FNV-1a; incremental, so large inputs can be hashed in chunks
+struct Fnv1a
+{
+	static constexpr std::uint64_t offsetBasis { 0xcbf29ce484222325ull };
+	static constexpr std::uint64_t prime       { 0x100000001b3ull };
+
+	std::uint64_t value { offsetBasis };
+
+	inline void update(const void *data, size_t size)
+	{
+		const auto *bytes = static_cast<const std::uint8_t *>(data);
+		for(size_t idx = 0; idx < size; ++idx)
+		{
+			value ^= bytes[idx];
+			value *= prime;
+		}
+	}
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "grobj/grimrock.h"
+
+
+// Decompress a raw deflate (RFC 1951) stream; fails as soon as the output would exceed 'maxSize'.
+std::variant<std::string, std::vector<byte>> inflate(const byte *data, size_t size, size_t maxSize);
+
+// Decompress a zlib (RFC 1950) wrapped deflate stream.
+std::variant<std::string, std::vector<byte>> zlib_inflate(const byte *data, size_t size, size_t maxSize);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "grobj/grimrock.h"
+
+
+struct Closer
+{
+	~Closer() { std::fclose(fp); }
+	std::FILE *fp;
+};
+
+std::variant<std::string, ModelFile> read_model(std::string_view filename);
+std::variant<std::string, ModelFile> read_model(const byte *data, size_t size);  // from memory
+std::string write_obj(std::string filename, const ModelFile &model);
+std::string write_obj(std::string filename, const MeshData &mesh);
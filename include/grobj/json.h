@@ -0,0 +1,28 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+
+#include "grobj/grimrock.h"
+
+
+// Minimal JSON support; enough for flat objects of strings, numbers and booleans.
+
+struct JsonValue
+{
+	bool        isString { false };
+	std::string text;     // unescaped if a string, otherwise the literal token (true, false, null or a number)
+};
+
+using JsonObject = std::unordered_map<std::string, JsonValue>;
+
+std::variant<std::string, JsonObject> json_object_parse(std::string_view s);
+
+bool json_bool(const JsonObject &obj, const char *key);          // false if missing
+std::string json_string(const JsonObject &obj, const char *key); // empty if missing
+
+void json_escape(std::ostream &out, std::string_view s);  // writes a quoted string
+void json_vec3(std::ostream &out, const Vec3 &v);         // writes [x,y,z]
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+
+#include "grobj/grimrock.h"
+
+
+inline Vec3 operator + (const Vec3 &a, const Vec3 &b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Vec3 operator - (const Vec3 &a, const Vec3 &b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Vec3 operator * (const Vec3 &v, float32 s) { return { v.x*s, v.y*s, v.z*s }; }
+
+inline float32 dot(const Vec3 &a, const Vec3 &b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+inline Vec3 cross(const Vec3 &a, const Vec3 &b) { return { a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x }; }
+inline float32 length(const Vec3 &v) { return std::sqrt(dot(v, v)); }
+
+inline Vec3 normalize(const Vec3 &v)
+{
+	const auto len = length(v);
+	return len > 0? v*(1/len): v;
+}
+
+// ----------------------------------------------------------------------------
+// A Mat4x3 maps p to  p.x*baseX + p.y*baseY + p.z*baseZ + translation
+
+inline Vec3 transform_vector(const Mat4x3 &m, const Vec3 &v)
+{
+	return m.baseX*v.x + m.baseY*v.y + m.baseZ*v.z;
+}
+
+inline Vec3 transform_point(const Mat4x3 &m, const Vec3 &p)
+{
+	return transform_vector(m, p) + m.translation;
+}
+
+// the transform applying 'inner' first, then 'outer'
+inline Mat4x3 compose(const Mat4x3 &outer, const Mat4x3 &inner)
+{
+	return {
+		transform_vector(outer, inner.baseX),
+		transform_vector(outer, inner.baseY),
+		transform_vector(outer, inner.baseZ),
+		transform_point(outer, inner.translation),
+	};
+}
+
+// ----------------------------------------------------------------------------
+// Float32 vertex arrays
+
+// whether 'va' holds at least 'dim' floats per vertex
+inline bool usable(const VertexArray &va, size_t dim)
+{
+	return va and va.dataType == Float32 and size_t(va.dim) >= dim and size_t(va.stride) >= dim*sizeof(float32);
+}
+
+inline float32 read_component(const VertexArray &va, size_t vertex, size_t comp)
+{
+	float32 f;
+	std::memcpy(&f, va.rawVertexData.data() + vertex*size_t(va.stride) + comp*sizeof(float32), sizeof(f));
+	return f;
+}
+
+inline Vec3 read_vec3(const VertexArray &va, size_t vertex)
+{
+	Vec3 v;
+	std::memcpy(&v, va.rawVertexData.data() + vertex*size_t(va.stride), sizeof(v));
+	return v;
+}
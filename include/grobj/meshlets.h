@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "grobj/grimrock.h"
+
+
+class ThreadPool;
+
+static constexpr size_t maxMeshletVertices  { 64 };
+static constexpr size_t maxMeshletTriangles { 124 };
+
+struct Meshlet
+{
+	std::uint32_t vertexOffset;    // first entry in MeshletSet::vertices
+	std::uint32_t triangleOffset;  // first entry in MeshletSet::triangles (3 per triangle)
+	std::uint8_t  vertexCount;
+	std::uint8_t  triangleCount;
+	Vec3          center;          // bounding sphere
+	float32       radius;
+	Vec3          coneApex;        // normal cone; the meshlet is back-facing if
+	Vec3          coneAxis;        //   dot(normalize(coneApex - camera), coneAxis) >= coneCutoff
+	float32       coneCutoff;      // 1 if the cone is too wide to ever cull
+};
+
+// The meshlets of one MeshSegment
+struct MeshletSet
+{
+	int32                      node;       // index in ModelFile::nodes
+	int32                      segment;    // index in MeshData::segments
+	std::vector<Meshlet>       meshlets;
+	std::vector<std::uint32_t> vertices;   // indices into the node's vertex arrays
+	std::vector<std::uint8_t>  triangles;  // indices into the meshlet's slice of 'vertices'
+};
+
+MeshletSet build_meshlets(const MeshData &md, const MeshSegment &segment);
+
+// All segments of all nodes, built on 'pool' if given
+std::vector<MeshletSet> build_meshlets(const ModelFile &model, ThreadPool *pool=nullptr);
+
+// Average fill of the meshlets' vertex and triangle capacity, 0..1
+void meshlet_fill(const std::vector<MeshletSet> &sets, double &vertexFill, double &triangleFill);
+
+// Binary side-file, all little-endian:
+//
+//   FourCC   magic;          // "MSHL"
+//   int32    version;        // 1
+//   int32    numSets;
+//   per set:
+//     int32    node, segment;
+//     int32    numMeshlets, numVertices, numTriangles;
+//     Meshlet  meshlets[numMeshlets];     // 56 bytes each:
+//                                         //   uint32 vertexOffset, triangleOffset;
+//                                         //   uint8 vertexCount, triangleCount; uint16 padding;
+//                                         //   float32 center[3], radius, coneApex[3], coneAxis[3], coneCutoff;
+//     uint32   vertices[numVertices];
+//     uint8    triangles[numTriangles * 3];
+std::string write_meshlets(std::string filename, const std::vector<MeshletSet> &sets);
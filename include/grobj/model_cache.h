@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+
+#include "grobj/grimrock.h"
+
+
+// Approximate heap + inline footprint of a parsed model
+size_t memory_size(const ModelFile &mf);
+
+// Thread-safe LRU cache of parsed models, bounded by (approximate) memory use.
+// An entry is reloaded if the file's size or modification time has changed.
+class ModelCache
+{
+public:
+	using Model = std::shared_ptr<const ModelFile>;
+
+	struct Stats
+	{
+		size_t entries;
+		size_t bytes;
+		size_t hits;
+		size_t misses;
+		size_t evictions;
+	};
+
+public:
+	explicit ModelCache(size_t maxBytes);
+
+	// 'hit' is set to whether the model was served from the cache
+	std::variant<std::string, Model> get(const std::string &filename, bool &hit);
+
+	Stats stats() const;
+
+private:
+	struct Entry
+	{
+		std::string                     filename;
+		std::uintmax_t                  fileSize;
+		std::filesystem::file_time_type mtime;
+		size_t                          bytes;
+		Model                           model;
+	};
+	using EntryList = std::list<Entry>;
+
+	void evict_locked();
+
+private:
+	const size_t _maxBytes;
+	mutable std::mutex _mutex;
+	EntryList _lru;  // most recently used first
+	std::unordered_map<std::string_view, EntryList::iterator> _index;  // keys view into Entry::filename
+	size_t _bytes { 0 };
+	size_t _hits { 0 };
+	size_t _misses { 0 };
+	size_t _evictions { 0 };
+};
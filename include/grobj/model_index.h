@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "grobj/grimrock.h"
+
+
+using NameId = std::uint32_t;
+static constexpr NameId noName { ~NameId(0) };
+
+// Interned strings: each distinct string is stored once and identified by a dense id.
+//   Can be shared by several models (e.g. a batch); not synchronized.
+class StringTable
+{
+public:
+	NameId intern(std::string_view s);
+	NameId find(std::string_view s) const;  // noName if never interned
+
+	inline std::string_view str(NameId id) const { return _strings[id]; }
+	inline size_t size() const { return _strings.size(); }
+
+private:
+	std::deque<std::string>                      _strings;  // deque: views into it stay valid
+	std::unordered_map<std::string_view, NameId> _ids;
+};
+
+struct SegmentRef
+{
+	int32 node;     // index in ModelFile::nodes
+	int32 segment;  // index in MeshData::segments
+};
+
+// Lookup tables over a ModelFile: node by name, segments by material, children of a node.
+//   The model must not change while the index is in use.
+class ModelIndex
+{
+public:
+	struct Children
+	{
+		const int32 *first;
+		const int32 *last;
+
+		inline const int32 *begin() const { return first; }
+		inline const int32 *end() const { return last; }
+		inline size_t size() const { return size_t(last - first); }
+	};
+
+public:
+	explicit ModelIndex(const ModelFile &model, std::shared_ptr<StringTable> names=nullptr);
+
+	int32 find_node(std::string_view name) const;  // -1 if no such node (first one, if not unique)
+	inline NameId node_name(int32 node) const { return node >= 0 and size_t(node) < _nodeNames.size()? _nodeNames[size_t(node)]: noName; }
+
+	Children children(int32 node) const;
+	inline const std::vector<int32> &roots() const { return _roots; }
+
+	// materials in order of first use
+	inline const std::vector<NameId> &materials() const { return _materials; }
+	const std::vector<SegmentRef> &segments(NameId material) const;  // in node order
+	const std::vector<SegmentRef> &segments(std::string_view material) const;
+
+	inline const StringTable &names() const { return *_names; }
+
+private:
+	std::shared_ptr<StringTable>                        _names;
+	std::vector<NameId>                                 _nodeNames;
+	std::unordered_map<NameId, int32>                   _nodeByName;
+	std::vector<NameId>                                 _materials;
+	std::unordered_map<NameId, std::vector<SegmentRef>> _segmentsByMaterial;
+	std::vector<int32>                                  _childOffsets;  // children of node N: _children[_childOffsets[N] .. _childOffsets[N + 1]]
+	std::vector<int32>                                  _children;
+	std::vector<int32>                                  _roots;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+struct ServeOptions
+{
+	std::string socketPath;   // listen on this Unix socket; empty = use stdin/stdout
+	size_t      numThreads;   // 0 = one per hardware thread
+	size_t      cacheBytes;   // memory budget of the parsed-model cache
+};
+
+// Process newline-delimited JSON requests until end of input (or a "shutdown" request).
+//   Each request is an object such as:
+//     {"id": 1, "cmd": "dump", "file": "a.model", "empty": true}
+//   and is answered by exactly one line:
+//     {"id": 1, "ok": true, "cached": true, "latency_us": 12.5, ...}
+//   Requests are processed concurrently, hence responses may arrive out of order.
+int serve(const ServeOptions &opts);
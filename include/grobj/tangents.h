@@ -0,0 +1,48 @@
+#pragma once
+
+#include <ostream>
+
+#include "grobj/grimrock.h"
+
+
+class ThreadPool;
+
+enum class NormalWeighting
+{
+	Area,    // each face contributes proportional to its area
+	Angle,   // each face contributes proportional to its corner angle at the vertex
+};
+
+struct TangentSpaceResult
+{
+	bool normals;      // whether the array was generated
+	bool tangents;
+	bool bitangents;
+	size_t splitVertices;  // vertices duplicated at mirrored-uv seams
+};
+
+// Fill in those of normalArray, tangentArray and bitangentArray that are unused (dim == 0)
+//   (normalArray also if it isn't float xyz, since the tangents are derived from it),
+//   from positionArray, texCoordArray[0] (needed for tangents) and indices.
+//   Tangents are accumulated as in MikkTSpace: each face's tangent is projected onto the vertex
+//   normal's plane and weighted by the corner angle between the likewise projected edges, and
+//   faces of opposite uv orientation don't share a vertex's tangent: a vertex on a mirrored-uv
+//   seam is split (appended to all vertex arrays, and the indices updated). The bitangent is
+//   cross(normal, tangent) times the handedness, using the mesh's own tangents if it has them
+//   (as float xyz). Unlike MikkTSpace, vertices are identified by index rather than welded by value.
+//   Triangle blocks are processed on 'pool', if given.
+TangentSpaceResult generate_tangent_space(MeshData &md, NormalWeighting weighting, ThreadPool *pool=nullptr);
+
+// The above for every mesh of the model.
+struct TangentSpaceTotals
+{
+	size_t arrays;         // generated
+	size_t splitVertices;
+};
+TangentSpaceTotals generate_tangent_space(ModelFile &model, NormalWeighting weighting, ThreadPool *pool=nullptr);
+
+// Straightforward single-threaded version of the above, used to verify it.
+TangentSpaceResult generate_tangent_space_reference(MeshData &md, NormalWeighting weighting);
+
+// Regenerate all three arrays of every mesh with both of the above; report timings and deviations.
+void verify_tangent_space(const ModelFile &model, NormalWeighting weighting, ThreadPool *pool, std::ostream &out);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// A fixed set of worker threads consuming a FIFO of tasks.
+class ThreadPool
+{
+public:
+	using Task = std::function<void()>;
+
+	explicit ThreadPool(size_t numThreads=0); // 0 = one per hardware thread
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator = (const ThreadPool &) = delete;
+
+	void submit(Task task);
+	void wait();  // block until every submitted task has finished
+
+	inline size_t size() const { return _workers.size(); }
+
+private:
+	void worker();
+
+private:
+	std::vector<std::thread> _workers;
+	std::deque<Task>         _tasks;
+	std::mutex               _mutex;
+	std::condition_variable  _taskAvailable;
+	std::condition_variable  _idle;
+	size_t                   _busy { 0 };
+	bool                     _stopping { false };
+};
+
+// Split [0, count) into (at most) 'numBlocks' contiguous ranges and run fn(block, begin, end)
+//   for each, on the pool if there is one. Returns when all blocks are done.
+//   Unlike ThreadPool::wait() this only waits for its own tasks (must not be called from a pool task).
+template<typename Fn>
+void parallel_blocks(ThreadPool *pool, size_t count, size_t numBlocks, Fn fn)
+{
+	if(numBlocks > count)
+		numBlocks = count;
+	if(numBlocks == 0)
+		return;
+
+	const auto blockSize = (count + numBlocks - 1) / numBlocks;
+	numBlocks = (count + blockSize - 1) / blockSize;
+
+	if(not pool or numBlocks == 1)
+	{
+		for(size_t block = 0; block < numBlocks; ++block)
+			fn(block, block*blockSize, std::min(count, (block + 1)*blockSize));
+		return;
+	}
+
+	std::mutex mutex;
+	std::condition_variable done;
+	auto remaining = numBlocks;
+
+	for(size_t block = 0; block < numBlocks; ++block)
+	{
+		pool->submit([&, block] {
+			fn(block, block*blockSize, std::min(count, (block + 1)*blockSize));
+
+			std::unique_lock lock(mutex);
+			if(--remaining == 0)
+				done.notify_one();
+		});
+	}
+
+	std::unique_lock lock(mutex);
+	done.wait(lock, [&] { return remaining == 0; });
+}
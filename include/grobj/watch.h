@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "grobj/tangents.h"
+
+
+struct WatchOptions
+{
+	std::string     inputDir;          // tree of .model files to watch
+	std::string     outputDir;         // converted files mirror the input tree here; empty = next to the inputs
+	size_t          numThreads;        // 0 = one per hardware thread
+	unsigned        debounceMs;        // quiet period before a burst of changes is processed
+	bool            generateTangents;  // before converting
+	NormalWeighting normalWeighting;
+};
+
+// Convert every .model in the input tree that changed since the last run, then keep
+//   watching (inotify) and reconvert whatever changes, until interrupted.
+//   The state is kept in a manifest file ('.grobj-manifest' in the output directory).
+int watch(const WatchOptions &opts);
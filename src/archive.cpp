@@ -0,0 +1,386 @@
+#include "grobj/archive.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "grobj/batch.h"
+#include "grobj/inflate.h"
+#include "grobj/io.h"
+#include "grobj/meshlets.h"
+#include "grobj/thread_pool.h"
+
+using namespace std::chrono;
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+
+// ----------------------------------------------------------------------------
+
+std::uint32_t asset_name_hash(std::string_view name)
+{
+	std::uint32_t hash = 0x811c9dc5u;
+	for(auto ch: name)
+	{
+		if(ch == '\\')
+			ch = '/';
+		hash ^= std::uint8_t(std::tolower(static_cast<unsigned char>(ch)));
+		hash *= 0x01000193u;
+	}
+	return hash;
+}
+
+// ----------------------------------------------------------------------------
+
+static std::uint32_t uint32_at(const byte *p)
+{
+	std::uint32_t u32;
+	std::memcpy(&u32, p, sizeof(u32));
+	return u32;
+}
+
+// ----------------------------------------------------------------------------
+
+std::variant<std::string, Archive> Archive::open(const std::string &filename)
+{
+	const auto fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return "FAILED: "s + std::strerror(errno);
+
+	struct stat st {};
+	if(::fstat(fd, &st) != 0)
+	{
+		const auto error = errno;
+		::close(fd);
+		return "FAILED: "s + std::strerror(error);
+	}
+
+	const auto size = size_t(st.st_size);
+	if(size < 8)
+	{
+		::close(fd);
+		return "FAILED: not an archive (too small)"s;
+	}
+
+	auto *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);  // the mapping stays valid
+	if(map == MAP_FAILED)
+		return "FAILED: mmap: "s + std::strerror(errno);
+
+	Archive archive;
+	archive._map = static_cast<const byte *>(map);
+	archive._size = size;
+
+	const auto *p = archive._map;
+	if(std::memcmp(p, "GRA2", 4) != 0)
+		return "FAILED: not an archive (bad magic)"s;
+
+	const auto numEntries = size_t(uint32_at(p + 4));
+	if(8 + numEntries*16 > size)
+		return "FAILED: truncated archive directory"s;
+
+	archive._entries.reserve(numEntries);
+	archive._index.reserve(numEntries);
+	for(auto idx = 0u; idx < numEntries; ++idx)
+	{
+		const auto *e = p + 8 + idx*16;
+		ArchiveEntry entry { uint32_at(e), uint32_at(e + 4), uint32_at(e + 8), uint32_at(e + 12) };
+
+		const auto stored = size_t(entry.compressed()? entry.compressedSize: entry.size);
+		if(size_t(entry.offset) + stored > size)
+			return "FAILED: entry " + std::to_string(idx) + " out of bounds";
+
+		archive._index.emplace(entry.nameHash, archive._entries.size());
+		archive._entries.push_back(entry);
+	}
+
+	return archive;
+}
+
+// ----------------------------------------------------------------------------
+
+Archive::Archive(Archive &&other) noexcept :
+	_map(other._map),
+	_size(other._size),
+	_entries(std::move(other._entries)),
+	_index(std::move(other._index))
+{
+	other._map = nullptr;
+	other._size = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+Archive::~Archive()
+{
+	if(_map)
+		::munmap(const_cast<byte *>(_map), _size);
+}
+
+// ----------------------------------------------------------------------------
+
+const ArchiveEntry *Archive::find(std::uint32_t nameHash) const
+{
+	auto found = _index.find(nameHash);
+	return found == _index.end()? nullptr: &_entries[found->second];
+}
+
+// ----------------------------------------------------------------------------
+
+const ArchiveEntry *Archive::find(std::string_view name) const
+{
+	if(not name.empty() and name[0] == '#')
+	{
+		const std::string hex(name.substr(1));
+		char *end = nullptr;
+		const auto hash = std::strtoul(hex.c_str(), &end, 16);
+		if(end == hex.c_str() or *end != '\0')
+			return nullptr;
+		return find(std::uint32_t(hash));
+	}
+
+	return find(asset_name_hash(name));
+}
+
+// ----------------------------------------------------------------------------
+
+std::variant<std::string, const byte *> Archive::data(const ArchiveEntry &entry, std::vector<byte> &buffer) const
+{
+	const auto *stored = _map + entry.offset;
+	if(not entry.compressed())
+		return stored;
+
+	// zlib stream, possibly preceded by its uncompressed size
+	auto size = size_t(entry.compressedSize);
+	if(size >= 6 and uint32_at(stored) == entry.size and stored[4] == 0x78)
+	{
+		stored += 4;
+		size -= 4;
+	}
+
+	auto data_ = stored[0] == 0x78? zlib_inflate(stored, size, entry.size): inflate(stored, size, entry.size);
+	if(std::holds_alternative<std::string>(data_))
+		return std::get<std::string>(data_);
+
+	buffer = std::move(std::get<std::vector<byte>>(data_));
+	if(buffer.size() != entry.size)
+		return "FAILED: decompressed size mismatch ("s + std::to_string(buffer.size()) + " != " + std::to_string(entry.size) + ")";
+
+	return static_cast<const byte *>(buffer.data());
+}
+
+// ----------------------------------------------------------------------------
+
+std::variant<std::string, ModelFile> Archive::read_model(const ArchiveEntry &entry) const
+{
+	std::vector<byte> buffer;
+	auto data_ = data(entry, buffer);
+	if(std::holds_alternative<std::string>(data_))
+		return std::get<std::string>(data_);
+
+	const auto *data = std::get<const byte *>(data_);
+	if(entry.size < 4 or std::memcmp(data, "MDL1", 4) != 0)
+		return "FAILED: not a model"s;
+
+	try
+	{
+		return ::read_model(data, entry.size);
+	}
+	catch(const std::exception &e)
+	{
+		return "FAILED: "s + e.what();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+static std::string entry_name(const ArchiveEntry &entry)
+{
+	char name[10];
+	std::snprintf(name, sizeof(name), "#%08x", entry.nameHash);
+	return name;
+}
+
+// ----------------------------------------------------------------------------
+
+// Where an entry is converted to; its directory is kept, so a/x.model and b/x.model don't
+//   both become x.obj. Names given by hash, or that would leave the output directory, use the hash.
+static fs::path output_path(const std::string &outputDir, const ArchiveEntry &entry, std::string name)
+{
+	std::replace(name.begin(), name.end(), '\\', '/');
+	auto relative = fs::path(name).lexically_normal();
+	if(name.empty() or name[0] == '#' or relative.is_absolute() or not relative.has_filename() or *relative.begin() == "..")
+		relative = entry_name(entry).substr(1);
+
+	return (fs::path(outputDir) / relative).replace_extension(".obj");
+}
+
+// ----------------------------------------------------------------------------
+
+int process_archive(const ArchiveOptions &opts)
+{
+	const auto T0 = steady_clock::now();
+
+	auto archive_ = Archive::open(opts.archiveFile);
+	if(std::holds_alternative<std::string>(archive_))
+	{
+		std::cerr << "[" << opts.archiveFile << "]: " << std::get<std::string>(archive_) << '\n';
+		return 1;
+	}
+	const auto &archive = std::get<Archive>(archive_);
+
+	// what to process, and what to call it
+	std::vector<std::pair<const ArchiveEntry *, std::string>> selected;
+	if(opts.names.empty())
+	{
+		for(const auto &entry: archive.entries())
+			selected.emplace_back(&entry, entry_name(entry));
+	}
+	else
+	{
+		for(const auto &name: opts.names)
+		{
+			const auto *entry = archive.find(name);
+			if(not entry)
+				std::cerr << "[" << name << "]: no such entry\n";
+			else if(std::none_of(selected.begin(), selected.end(), [entry](const auto &s) { return s.first == entry; }))
+				selected.emplace_back(entry, name);  // once; names of one entry would share its output
+		}
+	}
+
+	if(not opts.outputDir.empty())
+	{
+		std::error_code ec;
+		fs::create_directories(opts.outputDir, ec);
+	}
+
+	// output is collected per entry, and printed in archive order
+	std::vector<std::string> reports(selected.size());
+	std::vector<char> failed(selected.size(), false);  // not vector<bool>; written concurrently
+	const auto explicitNames = not opts.names.empty();
+
+	ThreadPool pool(opts.numThreads);
+	parallel_blocks(&pool, selected.size(), selected.size(), [&](size_t idx, size_t, size_t) {
+		const auto &[entry, name] = selected[idx];
+		std::ostringstream out;
+
+		if(opts.list)
+		{
+			std::vector<byte> buffer;
+			auto data_ = archive.data(*entry, buffer);
+			const char *kind = "?";
+			if(std::holds_alternative<const byte *>(data_))
+				kind = (entry->size >= 4 and std::memcmp(std::get<const byte *>(data_), "MDL1", 4) == 0)? "model": "-";
+
+			out << entry_name(*entry) << "  " << entry->size << " bytes";
+			if(entry->compressed())
+				out << " (" << entry->compressedSize << " compressed)";
+			out << "  " << kind << '\n';
+			reports[idx] = out.str();
+			return;
+		}
+
+		const auto T0 = steady_clock::now();
+		auto model_ = archive.read_model(*entry);
+		if(std::holds_alternative<std::string>(model_))
+		{
+			// when processing everything, non-models are expected and skipped silently
+			if(explicitNames or std::get<std::string>(model_) != "FAILED: not a model")
+			{
+				out << "[" << name << "]: " << std::get<std::string>(model_) << '\n';
+				failed[idx] = true;
+			}
+			reports[idx] = out.str();
+			return;
+		}
+		auto &model = std::get<ModelFile>(model_);
+		const auto T1 = steady_clock::now();
+
+		out << "[" << name << "] read " << model.nodes.size() << " nodes  (" << duration_cast<microseconds>(T1 - T0).count() << " µs):\n";
+		if(opts.generateTangents)
+		{
+			// already on a pool thread; entries are the unit of parallelism here
+			const auto generated = generate_tangent_space(model, opts.normalWeighting);
+			out << "[" << name << "] generated " << generated.arrays << " vertex arrays";
+			if(generated.splitVertices)
+				out << ", split " << generated.splitVertices << " vertices at mirrored uv seams";
+			out << '\n';
+		}
+		if(opts.dump)
+			dump(model, out, opts.dumpFilter);
+
+		if(not opts.outputDir.empty())
+		{
+			const auto outputPath = output_path(opts.outputDir, *entry, name);
+			std::error_code ec;
+			fs::create_directories(outputPath.parent_path(), ec);
+			const auto output = outputPath.string();
+
+			std::string error;
+			if(opts.mergeMaterials)
+			{
+				const auto batches = batch_by_material(model);
+				error = write_obj(output, batches);
+				out << "[" << name << "] draw calls: " << draw_calls(model) << " -> " << batches.size() << '\n';
+			}
+			else
+				error = write_obj(output, model);
+			if(error.empty())
+				out << "[" << name << "] wrote Wavefront OBJ: " << output << '\n';
+			else
+			{
+				out << "[" << name << "] " << output << ": " << error << '\n';
+				failed[idx] = true;
+			}
+
+			if(error.empty() and opts.meshlets)
+			{
+				const auto meshlets = build_meshlets(model);
+				const auto meshletFile = fs::path(outputPath).replace_extension(".meshlets").string();
+				const auto meshletError = write_meshlets(meshletFile, meshlets);
+				if(meshletError.empty())
+				{
+					size_t count = 0;
+					for(const auto &set: meshlets)
+						count += set.meshlets.size();
+					double vertexFill, triangleFill;
+					meshlet_fill(meshlets, vertexFill, triangleFill);
+
+					out << "[" << name << "] wrote " << count << " meshlets: " << meshletFile
+						<< "  (fill: vertices " << int(vertexFill*100) << "%, triangles " << int(triangleFill*100) << "%)\n";
+				}
+				else
+				{
+					out << "[" << name << "] " << meshletFile << ": " << meshletError << '\n';
+					failed[idx] = true;
+				}
+			}
+		}
+
+		reports[idx] = out.str();
+	});
+
+	auto numFailed = 0u;
+	for(auto idx = 0u; idx < selected.size(); ++idx)
+	{
+		(failed[idx]? std::cerr: std::cout) << reports[idx];
+		numFailed += failed[idx]? 1: 0;
+	}
+
+	const auto T1 = steady_clock::now();
+	std::cout << "[" << fs::path(opts.archiveFile).filename().generic_string() << "] " << selected.size() << " entries processed  (" << duration_cast<microseconds>(T1 - T0).count() << " µs)\n";
+
+	return numFailed? 1: 0;
+}
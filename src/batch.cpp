@@ -0,0 +1,226 @@
+#include "grobj/batch.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "grobj/io.h"
+#include "grobj/math.h"
+
+using namespace std::literals;
+
+
+// ----------------------------------------------------------------------------
+
+std::vector<Mat4x3> world_transforms(const ModelFile &model, const ModelIndex &index)
+{
+	// top-down from the roots, so every parent is done before its children
+	//   (nodes caught in a parent cycle keep their local transform)
+	std::vector<Mat4x3> world;
+	world.reserve(model.nodes.size());
+	for(const auto &node: model.nodes)
+		world.push_back(node.localToParent);
+
+	std::vector<int32> pending(index.roots().rbegin(), index.roots().rend());
+	while(not pending.empty())
+	{
+		const auto parent = pending.back();
+		pending.pop_back();
+
+		for(const auto child: index.children(parent))
+		{
+			world[size_t(child)] = compose(world[size_t(parent)], model.nodes[size_t(child)].localToParent);
+			pending.push_back(child);
+		}
+	}
+
+	return world;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t draw_calls(const ModelFile &model)
+{
+	size_t count = 0;
+	for(const auto &node: model.nodes)
+	{
+		if(node.meshEntity)
+			count += node.meshEntity.value().meshData.segments.size();
+	}
+
+	return count;
+}
+
+// ----------------------------------------------------------------------------
+
+// Append one vertex of a mesh to the batch, transformed to world space.
+static void append_vertex(MaterialBatch &batch, const MeshData &md, const Mat4x3 &world, size_t vertex)
+{
+	const auto base = batch.numVertices();
+
+	const auto p = transform_point(world, read_vec3(md.positionArray, vertex));
+	batch.positions.insert(batch.positions.end(), { p.x, p.y, p.z });
+
+	// meshes without an attribute get zeros, if other meshes in the batch have it
+	if(usable(md.normalArray, 3))
+	{
+		// the linear part is fine for rotations and uniform scale, which is what these models use
+		batch.normals.resize(base*3);  // back-fill earlier vertices lacking normals
+		const auto n = normalize(transform_vector(world, read_vec3(md.normalArray, vertex)));
+		batch.normals.insert(batch.normals.end(), { n.x, n.y, n.z });
+	}
+	else if(not batch.normals.empty())
+		batch.normals.resize((base + 1)*3);
+
+	if(const auto &uv = md.texCoordArray[0]; usable(uv, 2))
+	{
+		batch.texCoords.resize(base*2);
+		batch.texCoords.insert(batch.texCoords.end(), { read_component(uv, vertex, 0), read_component(uv, vertex, 1) });
+	}
+	else if(not batch.texCoords.empty())
+		batch.texCoords.resize((base + 1)*2);
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<MaterialBatch> batch_by_material(const ModelFile &model)
+{
+	const ModelIndex index(model);
+	const auto world = world_transforms(model, index);
+
+	std::vector<MaterialBatch> batches;
+	batches.reserve(index.materials().size());
+
+	// node vertex -> batch vertex (-1 if not in the batch yet); only the touched entries are reset,
+	//   so the cost follows the referenced vertices rather than the nodes' full vertex counts
+	std::vector<int32> remap;
+	std::vector<size_t> touched;
+	auto reset_remap = [&] {
+		for(const auto vertex: touched)
+			remap[vertex] = -1;
+		touched.clear();
+	};
+
+	for(const auto material: index.materials())
+	{
+		auto &batch = batches.emplace_back();
+		batch.material = index.names().str(material);
+
+		// segments come in node order, so a node's vertices are shared by all its segments in the batch
+		auto currentNode = -1;
+
+		for(const auto &ref: index.segments(material))
+		{
+			const auto &md = model.nodes[size_t(ref.node)].meshEntity.value().meshData;
+			if(not usable(md.positionArray, 3))
+				continue;
+
+			if(ref.node != currentNode)
+			{
+				reset_remap();
+				currentNode = ref.node;
+				if(remap.size() < size_t(md.numVertices))
+					remap.resize(size_t(md.numVertices), -1);
+			}
+
+			const auto &seg = md.segments[size_t(ref.segment)];
+			const auto first = std::min(size_t(seg.firstIndex), md.indices.size());
+			const auto count = std::min(size_t(seg.count)*3, md.indices.size() - first);
+			for(auto idx = first; idx + 2 < first + count; idx += 3)
+			{
+				const auto *tri = md.indices.data() + idx;
+				if(std::any_of(tri, tri + 3, [&md](int32 vertex) { return vertex < 0 or vertex >= md.numVertices; }))
+					continue;
+
+				for(auto corner = 0u; corner < 3; ++corner)
+				{
+					const auto vertex = size_t(tri[corner]);
+					if(remap[vertex] < 0)
+					{
+						remap[vertex] = int32(batch.numVertices());
+						touched.push_back(vertex);
+						append_vertex(batch, md, world[size_t(ref.node)], vertex);
+					}
+					batch.indices.push_back(remap[vertex]);
+				}
+			}
+
+			++batch.segments;
+		}
+		reset_remap();
+
+		if(batch.segments == 0)
+			batches.pop_back();
+	}
+
+	return batches;
+}
+
+// ----------------------------------------------------------------------------
+
+std::string write_obj(std::string filename, const std::vector<MaterialBatch> &batches)
+{
+	auto *fp = std::fopen(filename.data(), "wb");
+	if(not fp)
+		return "FAILED: "s + std::strerror(errno);
+
+	Closer _{ fp };
+
+	std::fprintf(fp, "# %s\n", filename.c_str());
+
+	// OBJ indices are 1-based and global to the file, counted separately for v, vt and vn
+	size_t vertexBase = 1;
+	size_t normalBase = 1;
+	size_t texCoordBase = 1;
+
+	for(const auto &batch: batches)
+	{
+		const auto numVertices = batch.numVertices();
+		const auto hasNormals = not batch.normals.empty();
+		const auto hasTexCoords = not batch.texCoords.empty();
+
+		std::fprintf(fp, "o %s\nusemtl %s\n", batch.material.c_str(), batch.material.c_str());
+
+		for(auto idx = 0u; idx < numVertices; ++idx)
+			std::fprintf(fp, "v %f %f %f\n", double(batch.positions[idx*3]), double(batch.positions[idx*3 + 1]), double(batch.positions[idx*3 + 2]));
+		if(hasNormals)
+		{
+			for(auto idx = 0u; idx < numVertices; ++idx)
+				std::fprintf(fp, "vn %f %f %f\n", double(batch.normals[idx*3]), double(batch.normals[idx*3 + 1]), double(batch.normals[idx*3 + 2]));
+		}
+		if(hasTexCoords)
+		{
+			for(auto idx = 0u; idx < numVertices; ++idx)
+				std::fprintf(fp, "vt %f %f\n", double(batch.texCoords[idx*2]), double(batch.texCoords[idx*2 + 1]));
+		}
+
+		for(auto idx = 0u; idx + 2 < batch.indices.size(); idx += 3)
+		{
+			std::fputc('f', fp);
+			for(auto corner = 0u; corner < 3; ++corner)
+			{
+				const auto index = size_t(batch.indices[idx + corner]);
+				const auto v = vertexBase + index;
+				const auto vt = texCoordBase + index;
+				const auto vn = normalBase + index;
+				if(hasTexCoords and hasNormals)
+					std::fprintf(fp, " %zu/%zu/%zu", v, vt, vn);
+				else if(hasTexCoords)
+					std::fprintf(fp, " %zu/%zu", v, vt);
+				else if(hasNormals)
+					std::fprintf(fp, " %zu//%zu", v, vn);
+				else
+					std::fprintf(fp, " %zu", v);
+			}
+			std::fputc('\n', fp);
+		}
+
+		vertexBase += numVertices;
+		if(hasNormals)
+			normalBase += numVertices;
+		if(hasTexCoords)
+			texCoordBase += numVertices;
+	}
+
+	return {};
+}
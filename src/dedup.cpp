@@ -0,0 +1,372 @@
+#include "grobj/dedup.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <variant>
+
+#include "grobj/hash.h"
+#include "grobj/io.h"
+#include "grobj/json.h"
+#include "grobj/model_index.h"
+#include "grobj/thread_pool.h"
+
+using namespace std::chrono;
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+
+// a distinct mesh; only where it was first seen is kept, later matches are confirmed
+//   byte for byte against a re-read of that model
+struct MeshRecord
+{
+	std::string   id;
+	size_t        instances;
+	std::uint64_t bytes;
+	NameId        model;
+	size_t        node;
+};
+
+struct MeshSource
+{
+	size_t      record;  // index in the hash's records
+	std::string model;
+	size_t      node;
+};
+
+// names are interned; across a large batch they're mostly repeats
+struct Instance
+{
+	NameId model;
+	NameId node;
+	size_t index;
+	int32  parent;
+	Mat4x3 localToParent;
+	NameId mesh;
+};
+
+// ----------------------------------------------------------------------------
+
+static void hash_pod(Fnv1a &hash, std::uint64_t &bytes, const void *data, size_t size)
+{
+	hash.update(data, size);
+	bytes += size;
+}
+
+// ----------------------------------------------------------------------------
+
+MeshKey mesh_key(const MeshData &md)
+{
+	Fnv1a hash;
+	std::uint64_t bytes = 0;
+
+	hash_pod(hash, bytes, &md.numVertices, sizeof(md.numVertices));
+
+	auto hash_array = [&](const VertexArray &va) {
+		const int32 header[] { va.purpose, va.dataType, va.dim, va.stride };
+		hash_pod(hash, bytes, header, sizeof(header));
+		hash_pod(hash, bytes, va.rawVertexData.data(), va.rawVertexData.size());
+	};
+	for(const auto *va: { &md.positionArray, &md.normalArray, &md.tangentArray, &md.bitangentArray, &md.colorArray })
+		hash_array(*va);
+	for(const auto &va: md.texCoordArray)
+		hash_array(va);
+	hash_array(md.boneArray);
+	hash_array(md.boneWeightArray);
+
+	hash_pod(hash, bytes, md.indices.data(), md.indices.size()*sizeof(int32));
+
+	for(const auto &seg: md.segments)
+	{
+		const auto length = std::uint64_t(seg.material.size());
+		hash_pod(hash, bytes, &length, sizeof(length));
+		hash_pod(hash, bytes, seg.material.data(), seg.material.size());
+		const int32 fields[] { seg.primitiveType, seg.firstIndex, seg.count };
+		hash_pod(hash, bytes, fields, sizeof(fields));
+	}
+
+	return { hash.value, bytes };
+}
+
+// ----------------------------------------------------------------------------
+
+static bool same_array(const VertexArray &a, const VertexArray &b)
+{
+	return a.purpose == b.purpose and a.dataType == b.dataType and a.dim == b.dim and a.stride == b.stride and a.rawVertexData == b.rawVertexData;
+}
+
+// ----------------------------------------------------------------------------
+
+// Exactly the contents mesh_key() covers.
+static bool same_mesh(const MeshData &a, const MeshData &b)
+{
+	if(a.numVertices != b.numVertices or a.indices != b.indices or a.segments.size() != b.segments.size())
+		return false;
+
+	if(not same_array(a.positionArray, b.positionArray) or not same_array(a.normalArray, b.normalArray)
+		or not same_array(a.tangentArray, b.tangentArray) or not same_array(a.bitangentArray, b.bitangentArray)
+		or not same_array(a.colorArray, b.colorArray) or not same_array(a.boneArray, b.boneArray)
+		or not same_array(a.boneWeightArray, b.boneWeightArray))
+		return false;
+	for(auto idx = 0u; idx < std::size(a.texCoordArray); ++idx)
+	{
+		if(not same_array(a.texCoordArray[idx], b.texCoordArray[idx]))
+			return false;
+	}
+
+	for(auto idx = 0u; idx < a.segments.size(); ++idx)
+	{
+		const auto &sa = a.segments[idx];
+		const auto &sb = b.segments[idx];
+		if(sa.material != sb.material or sa.primitiveType != sb.primitiveType or sa.firstIndex != sb.firstIndex or sa.count != sb.count)
+			return false;
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// the hash, plus a suffix for any further (colliding) meshes sharing it
+static std::string key_id(const MeshKey &key, size_t collision)
+{
+	char id[40];
+	if(collision == 0)
+		std::snprintf(id, sizeof(id), "%016jx", std::uintmax_t(key.hash));
+	else
+		std::snprintf(id, sizeof(id), "%016jx-%zu", std::uintmax_t(key.hash), collision);
+	return id;
+}
+
+// ----------------------------------------------------------------------------
+
+static void write_manifest(std::ostream &out, const std::vector<MeshRecord> &meshes, const std::vector<Instance> &instances, const StringTable &names)
+{
+	out << "{\n  \"meshes\": [";
+	auto first = true;
+	for(const auto &mesh: meshes)
+	{
+		out << (first? "\n    ": ",\n    ") << "{\"id\":\"" << mesh.id << "\",\"file\":\"meshes/" << mesh.id << ".obj\",\"instances\":" << mesh.instances << '}';
+		first = false;
+	}
+	out << "\n  ],\n  \"instances\": [";
+
+	first = true;
+	for(const auto &inst: instances)
+	{
+		out << (first? "\n    ": ",\n    ") << "{\"model\":";
+		json_escape(out, names.str(inst.model));
+		out << ",\"node\":";
+		json_escape(out, names.str(inst.node));
+		out << ",\"index\":" << inst.index << ",\"parent\":" << inst.parent << ",\"mesh\":\"" << names.str(inst.mesh) << "\",\"localToParent\":[";
+		json_vec3(out, inst.localToParent.baseX);
+		out << ',';
+		json_vec3(out, inst.localToParent.baseY);
+		out << ',';
+		json_vec3(out, inst.localToParent.baseZ);
+		out << ',';
+		json_vec3(out, inst.localToParent.translation);
+		out << "]}";
+		first = false;
+	}
+	out << "\n  ]\n}\n";
+}
+
+// ----------------------------------------------------------------------------
+
+int dedup(const std::vector<std::string> &filenames, const DedupOptions &opts)
+{
+	const auto T0 = steady_clock::now();
+
+	const fs::path outputRoot(opts.outputDir);
+	const auto meshDir = outputRoot / "meshes";
+	std::error_code ec;
+	fs::create_directories(meshDir, ec);
+	if(ec)
+	{
+		std::cerr << "failed creating " << meshDir.generic_string() << ": " << ec.message() << '\n';
+		return 1;
+	}
+
+	std::mutex mutex;
+	std::unordered_map<std::uint64_t, std::vector<MeshRecord>> meshes;  // by hash; more than one only on a collision
+	std::vector<Instance> instances;
+	StringTable names;
+	std::uint64_t totalBytes = 0;
+	std::uint64_t uniqueBytes = 0;
+	auto failures = 0u;
+
+	// each model is parsed, hashed and released by one task;
+	//   only the keys, first occurrences and instance records are kept across files
+	ThreadPool pool(opts.numThreads);
+	for(const auto &filename: filenames)
+	{
+		pool.submit([&, filename] {
+			std::variant<std::string, ModelFile> model_;
+			try
+			{
+				model_ = read_model(filename);
+			}
+			catch(const std::exception &e)
+			{
+				model_ = "FAILED: "s + e.what();
+			}
+			if(std::holds_alternative<std::string>(model_))
+			{
+				std::unique_lock lock(mutex);
+				std::cerr << "[" << filename << "]: " << std::get<std::string>(model_) << '\n';
+				++failures;
+				return;
+			}
+			auto &model = std::get<ModelFile>(model_);
+			if(opts.generateTangents)
+				generate_tangent_space(model, opts.normalWeighting);  // already on a pool thread
+
+			// the first occurrence of a candidate match, from this model or re-read from its file;
+			//   the last re-read model is kept, since instances of a mesh tend to come together
+			std::string reloadedFile;
+			std::optional<ModelFile> reloaded;
+			auto source_mesh = [&](const MeshSource &source) -> const MeshData * {
+				const ModelFile *from = &model;
+				if(source.model != filename)
+				{
+					if(source.model != reloadedFile)
+					{
+						reloadedFile = source.model;
+						reloaded.reset();
+						try
+						{
+							auto other_ = read_model(source.model);
+							if(std::holds_alternative<ModelFile>(other_))
+							{
+								reloaded = std::move(std::get<ModelFile>(other_));
+								if(opts.generateTangents)
+									generate_tangent_space(*reloaded, opts.normalWeighting);
+							}
+						}
+						catch(const std::exception &)
+						{
+							// left empty, as if it didn't match
+						}
+					}
+					if(not reloaded)
+						return nullptr;  // changed or gone since; treated as a different mesh
+					from = &*reloaded;
+				}
+				if(source.node >= from->nodes.size() or not from->nodes[source.node].meshEntity)
+					return nullptr;
+				return &from->nodes[source.node].meshEntity.value().meshData;
+			};
+
+			for(auto idx = 0u; idx < model.nodes.size(); ++idx)
+			{
+				const auto &node = model.nodes[idx];
+				if(not node.meshEntity)
+					continue;
+
+				const auto &md = node.meshEntity.value().meshData;
+				const auto key = mesh_key(md);
+
+				// compare against the meshes already recorded for this hash, outside the lock;
+				//   records are only ever appended, so only newcomers need checking on a retry
+				bool firstSeen = false;
+				std::string id;
+				size_t checked = 0;
+				auto add_instance = [&] {  // with the lock held
+					totalBytes += key.bytes;
+					instances.push_back({ names.intern(filename), names.intern(node.name), idx, node.parent, node.localToParent, names.intern(id) });
+				};
+				while(id.empty())
+				{
+					std::vector<MeshSource> candidates;
+					{
+						std::unique_lock lock(mutex);
+						auto &records = meshes[key.hash];
+						if(checked == records.size())
+						{
+							// no match; a new distinct mesh
+							records.push_back({ key_id(key, records.size()), 1, key.bytes, names.intern(filename), idx });
+							id = records.back().id;
+							firstSeen = true;
+							uniqueBytes += key.bytes;
+							add_instance();
+							break;
+						}
+						for(; checked < records.size(); ++checked)
+						{
+							if(records[checked].bytes == key.bytes)
+								candidates.push_back({ checked, std::string(names.str(records[checked].model)), records[checked].node });
+						}
+					}
+
+					for(const auto &candidate: candidates)
+					{
+						const auto *mesh = source_mesh(candidate);
+						if(not mesh or not same_mesh(*mesh, md))
+							continue;
+
+						std::unique_lock lock(mutex);
+						auto &record = meshes[key.hash][candidate.record];
+						++record.instances;
+						id = record.id;
+						add_instance();
+						break;
+					}
+				}
+
+				if(firstSeen)
+				{
+					const auto meshFile = (meshDir / (id + ".obj")).string();
+					if(auto error = write_obj(meshFile, md); not error.empty())
+					{
+						std::unique_lock lock(mutex);
+						std::cerr << "[" << filename << "] " << meshFile << ": " << error << '\n';
+					}
+				}
+			}
+		});
+	}
+	pool.wait();
+
+	// deterministic output regardless of task scheduling
+	std::vector<MeshRecord> records;
+	records.reserve(meshes.size());
+	for(auto &[hash, chain]: meshes)
+	{
+		for(auto &record: chain)
+			records.push_back(std::move(record));
+	}
+	std::sort(records.begin(), records.end(), [](const auto &a, const auto &b) { return a.id < b.id; });
+	// ids are assigned in scheduling order, so compare the names themselves
+	std::sort(instances.begin(), instances.end(), [&names](const auto &a, const auto &b) {
+		const auto modelA = names.str(a.model);
+		const auto modelB = names.str(b.model);
+		return modelA < modelB or (a.model == b.model and a.index < b.index);
+	});
+
+	const auto manifestFile = outputRoot / "manifest.json";
+	std::ofstream out(manifestFile, std::ios::trunc);
+	write_manifest(out, records, instances, names);
+	if(not out)
+	{
+		std::cerr << "failed writing " << manifestFile.generic_string() << '\n';
+		return 1;
+	}
+
+	const auto T1 = steady_clock::now();
+
+	const auto saved = totalBytes - uniqueBytes;
+	std::cout << "deduplicated " << (filenames.size() - failures) << " models: " << instances.size() << " mesh instances, " << records.size() << " unique meshes\n";
+	std::cout << "  mesh data: " << totalBytes << " bytes -> " << uniqueBytes << " bytes  (saved " << saved << " bytes, "
+		<< (totalBytes? 100.0*double(saved)/double(totalBytes): 0.0) << "%)\n";
+	std::cout << "  wrote " << manifestFile.generic_string() << "  (" << duration_cast<microseconds>(T1 - T0).count() << " µs)\n";
+
+	return failures? 1: 0;
+}
@@ -2,20 +2,34 @@
 
 // ----------------------------------------------------------------------------
 
+// " -> node.N 'name'", the name looked up through the index
+static void dump_node_ref(int32 node, std::ostream &out, const ModelIndex &modelIndex)
+{
+	out << " -> node." << node;
+	if(const auto name = modelIndex.node_name(node); name != noName)
+		out << " '" << modelIndex.names().str(name) << "'";
+	else
+		out << " (missing)";
+}
+
+// ----------------------------------------------------------------------------
+
 void dump(const ModelFile &mf, std::ostream &out, Filter filter)
 {
+	const ModelIndex modelIndex(mf);
+
 	out << "  nodes: " << mf.nodes.size() << '\n';
 	auto idx = 0u;
 	for(const auto &node: mf.nodes)
 	{
-		dump(node, out, filter, idx);
+		dump(node, out, filter, idx, modelIndex);
 		++idx;
 	}
 }
 
 // ----------------------------------------------------------------------------
 
-void dump(const Node &node, std::ostream &out, Filter filter, size_t index)
+void dump(const Node &node, std::ostream &out, Filter filter, size_t index, const ModelIndex &modelIndex)
 {
 	const auto is_empty = not node.meshEntity.has_value();
 
@@ -23,11 +37,11 @@ void dump(const Node &node, std::ostream &out, Filter filter, size_t index)
 	{
 		out << "    node." << index << ": '" << node.name << "'";
 		if(node.parent != -1)
-			out << " -> node." << node.parent;
+			dump_node_ref(node.parent, out, modelIndex);
 		if(not is_empty)
 		{
 			out << "  MeshEntity\n";
-			dump(node.meshEntity.value(), out, filter);
+			dump(node.meshEntity.value(), out, filter, modelIndex);
 		}
 		else
 			out << '\n';
@@ -36,7 +50,7 @@ void dump(const Node &node, std::ostream &out, Filter filter, size_t index)
 
 // ----------------------------------------------------------------------------
 
-void dump(const MeshEntity &me, std::ostream &out, Filter filter)
+void dump(const MeshEntity &me, std::ostream &out, Filter filter, const ModelIndex &modelIndex)
 {
 	dump(me.meshData, out, filter);
 
@@ -46,7 +60,7 @@ void dump(const MeshEntity &me, std::ostream &out, Filter filter)
 		auto idx = 0u;
 		for(const auto &bone: me.bones)
 		{
-			dump(bone, out, filter, idx);
+			dump(bone, out, filter, idx, modelIndex);
 			++idx;
 		}
 	}
@@ -118,8 +132,10 @@ void dump(const MeshSegment &ms, std::ostream &out, [[maybe_unused]] Filter filt
 
 // ----------------------------------------------------------------------------
 
-void dump(const Bone &bone, std::ostream &out, [[maybe_unused]] Filter filter, size_t index)
+void dump(const Bone &bone, std::ostream &out, [[maybe_unused]] Filter filter, size_t index, const ModelIndex &modelIndex)
 {
-	out << "        bone." << index << " -> node." << bone.nodeIndex << '\n';
+	out << "        bone." << index;
+	dump_node_ref(bone.nodeIndex, out, modelIndex);
+	out << '\n';
 }
 
@@ -0,0 +1,292 @@
+#include "grobj/inflate.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace std::literals;
+
+
+// Canonical Huffman decoding as described in RFC 1951, decoding one bit at a time
+//   via the per-length code counts (as in zlib's "puff").
+
+struct Huffman
+{
+	std::uint16_t counts[16];    // number of codes of each length
+	std::uint16_t symbols[288];  // symbols ordered by code
+};
+
+struct BitReader
+{
+	const byte *data;
+	size_t      size;
+	size_t      pos { 0 };
+	std::uint32_t bits { 0 };
+	unsigned    numBits { 0 };
+	bool        overrun { false };
+
+	inline unsigned get(unsigned count)
+	{
+		while(numBits < count)
+		{
+			if(pos >= size)
+			{
+				overrun = true;
+				return 0;
+			}
+			bits |= std::uint32_t(data[pos++]) << numBits;
+			numBits += 8;
+		}
+		const auto value = bits & ((1u << count) - 1);
+		bits >>= count;
+		numBits -= count;
+		return value;
+	}
+};
+
+static constexpr std::uint16_t lengthBase[29] { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static constexpr std::uint16_t lengthExtra[29] { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static constexpr std::uint16_t distBase[30] { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static constexpr std::uint16_t distExtra[30] { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// ----------------------------------------------------------------------------
+
+static bool huffman_build(Huffman &h, const std::uint8_t *lengths, size_t count)
+{
+	for(auto &c: h.counts)
+		c = 0;
+	for(auto idx = 0u; idx < count; ++idx)
+		++h.counts[lengths[idx]];
+	h.counts[0] = 0;
+
+	// reject over-subscribed codes (incomplete ones are allowed, e.g. a single distance code)
+	int left = 1;
+	for(auto len = 1u; len < 16; ++len)
+	{
+		left <<= 1;
+		left -= h.counts[len];
+		if(left < 0)
+			return false;
+	}
+
+	std::uint16_t offsets[16];
+	offsets[1] = 0;
+	for(auto len = 1u; len < 15; ++len)
+		offsets[len + 1] = std::uint16_t(offsets[len] + h.counts[len]);
+
+	for(auto idx = 0u; idx < count; ++idx)
+	{
+		if(lengths[idx] != 0)
+			h.symbols[offsets[lengths[idx]]++] = std::uint16_t(idx);
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+static int huffman_decode(BitReader &in, const Huffman &h)
+{
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	for(auto len = 1u; len < 16; ++len)
+	{
+		code |= int(in.get(1));
+		const int count = h.counts[len];
+		if(code - count < first)
+			return h.symbols[index + (code - first)];
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+		if(in.overrun)
+			return -1;
+	}
+	return -1;
+}
+
+// ----------------------------------------------------------------------------
+
+static std::string inflate_codes(BitReader &in, std::vector<byte> &out, size_t maxSize, const Huffman &lengths, const Huffman &dists)
+{
+	while(true)
+	{
+		const auto symbol = huffman_decode(in, lengths);
+		if(symbol < 0)
+			return "bad literal/length code";
+		if(symbol < 256)
+		{
+			if(out.size() >= maxSize)
+				return "output too large";
+			out.push_back(byte(symbol));
+			continue;
+		}
+		if(symbol == 256)
+			return {};
+
+		const auto lsym = size_t(symbol - 257);
+		if(lsym >= 29)
+			return "bad length symbol";
+		const auto length = size_t(lengthBase[lsym] + in.get(lengthExtra[lsym]));
+
+		const auto dsym = huffman_decode(in, dists);
+		if(dsym < 0 or dsym >= 30)
+			return "bad distance code";
+		const auto distance = size_t(distBase[dsym] + in.get(distExtra[dsym]));
+		if(in.overrun)
+			return "truncated data";
+		if(distance > out.size())
+			return "distance too far back";
+		if(length > maxSize - out.size())
+			return "output too large";
+
+		// may overlap itself, so byte by byte
+		const auto from = out.size() - distance;
+		for(auto idx = 0u; idx < length; ++idx)
+			out.push_back(out[from + idx]);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+static std::string inflate_fixed(BitReader &in, std::vector<byte> &out, size_t maxSize)
+{
+	static const auto tables = [] {
+		std::pair<Huffman, Huffman> t;
+		std::uint8_t lengths[288];
+		for(auto idx = 0u; idx < 288; ++idx)
+			lengths[idx] = idx < 144? 8: idx < 256? 9: idx < 280? 7: 8;
+		huffman_build(t.first, lengths, 288);
+		for(auto idx = 0u; idx < 30; ++idx)
+			lengths[idx] = 5;
+		huffman_build(t.second, lengths, 30);
+		return t;
+	}();
+
+	return inflate_codes(in, out, maxSize, tables.first, tables.second);
+}
+
+// ----------------------------------------------------------------------------
+
+static std::string inflate_dynamic(BitReader &in, std::vector<byte> &out, size_t maxSize)
+{
+	static constexpr std::uint8_t order[19] { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	const auto numLengths = in.get(5) + 257;
+	const auto numDists = in.get(5) + 1;
+	const auto numCodes = in.get(4) + 4;
+	if(in.overrun or numLengths > 286 or numDists > 30)
+		return "bad dynamic block header";
+
+	std::uint8_t lengths[286 + 30] { 0 };
+	for(auto idx = 0u; idx < numCodes; ++idx)
+		lengths[order[idx]] = std::uint8_t(in.get(3));
+
+	Huffman codes;
+	if(not huffman_build(codes, lengths, 19))
+		return "bad code lengths code";
+
+	for(auto idx = 0u; idx < numLengths + numDists; )
+	{
+		const auto symbol = huffman_decode(in, codes);
+		if(symbol < 0)
+			return "bad code lengths";
+		if(symbol < 16)
+		{
+			lengths[idx++] = std::uint8_t(symbol);
+			continue;
+		}
+
+		std::uint8_t value = 0;
+		unsigned repeat;
+		if(symbol == 16)
+		{
+			if(idx == 0)
+				return "repeat with no previous length";
+			value = lengths[idx - 1];
+			repeat = 3 + in.get(2);
+		}
+		else if(symbol == 17)
+			repeat = 3 + in.get(3);
+		else
+			repeat = 11 + in.get(7);
+
+		if(idx + repeat > numLengths + numDists)
+			return "too many code lengths";
+		while(repeat--)
+			lengths[idx++] = value;
+	}
+	if(lengths[256] == 0)
+		return "missing end-of-block code";
+
+	Huffman lencodes, distcodes;
+	if(not huffman_build(lencodes, lengths, numLengths) or not huffman_build(distcodes, lengths + numLengths, numDists))
+		return "bad literal/length or distance code lengths";
+
+	return inflate_codes(in, out, maxSize, lencodes, distcodes);
+}
+
+// ----------------------------------------------------------------------------
+
+std::variant<std::string, std::vector<byte>> inflate(const byte *data, size_t size, size_t maxSize)
+{
+	// deflate can't expand by more than ~1032:1, so a bogus maxSize doesn't reserve gigabytes
+	std::vector<byte> out;
+	out.reserve(std::min(maxSize, size*1032));
+
+	BitReader in { data, size };
+
+	bool last = false;
+	while(not last)
+	{
+		last = in.get(1) != 0;
+		const auto type = in.get(2);
+		if(in.overrun)
+			return "inflate: truncated data"s;
+
+		std::string error;
+		if(type == 0)
+		{
+			// stored; realign to a byte boundary
+			in.bits = 0;
+			in.numBits = 0;
+			if(in.pos + 4 > size)
+				return "inflate: truncated stored block"s;
+			const auto len = size_t(data[in.pos]) | size_t(data[in.pos + 1]) << 8;
+			const auto nlen = size_t(data[in.pos + 2]) | size_t(data[in.pos + 3]) << 8;
+			if(nlen != (~len & 0xffff))
+				return "inflate: stored block length check failed"s;
+			in.pos += 4;
+			if(in.pos + len > size)
+				return "inflate: truncated stored block"s;
+			if(len > maxSize - out.size())
+				return "inflate: output too large"s;
+			out.insert(out.end(), data + in.pos, data + in.pos + len);
+			in.pos += len;
+		}
+		else if(type == 1)
+			error = inflate_fixed(in, out, maxSize);
+		else if(type == 2)
+			error = inflate_dynamic(in, out, maxSize);
+		else
+			error = "bad block type";
+
+		if(not error.empty())
+			return "inflate: " + error;
+		if(in.overrun)
+			return "inflate: truncated data"s;
+	}
+
+	return out;
+}
+
+// ----------------------------------------------------------------------------
+
+std::variant<std::string, std::vector<byte>> zlib_inflate(const byte *data, size_t size, size_t maxSize)
+{
+	// 2-byte header: deflate method, no preset dictionary; the trailing adler32 is not checked
+	if(size < 2 or (data[0] & 0x0f) != 8 or ((data[0] << 8) | data[1]) % 31 != 0 or (data[1] & 0x20) != 0)
+		return "inflate: not a zlib stream"s;
+
+	return inflate(data + 2, size - 2, maxSize);
+}
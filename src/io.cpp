@@ -0,0 +1,168 @@
+#include "grobj/io.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <type_traits>
+
+using namespace std::literals;
+
+// ----------------------------------------------------------------------------
+
+std::variant<std::string, ModelFile> read_model(std::string_view filename)
+{
+	auto *fp = std::fopen(filename.data(), "rb");
+	if(not fp)
+		return "FAILED: "s + std::strerror(errno);
+
+	Closer _{ fp };
+
+	return ModelFile::read(fp);
+}
+
+// ----------------------------------------------------------------------------
+
+std::variant<std::string, ModelFile> read_model(const byte *data, size_t size)
+{
+	// read-only stream; fmemopen() just wants a non-const pointer
+	auto *fp = fmemopen(const_cast<byte *>(data), size, "rb");
+	if(not fp)
+		return "FAILED: "s + std::strerror(errno);
+
+	Closer _{ fp };
+
+	return ModelFile::read(fp);
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T>
+void write_vertices(std::FILE *fp, const char *vtype, const VertexArray &va, int32 numVertices)
+{
+	for(auto idx = 0; idx < numVertices; ++idx)
+	{
+		const auto *vertex = va.rawVertexData.data() + size_t(idx)*size_t(va.stride);
+		std::fputs(vtype, fp);
+		for(auto comp = 0; comp < va.dim; ++comp)
+		{
+			T value;
+			std::memcpy(&value, vertex + size_t(comp)*sizeof(T), sizeof(T));
+			if constexpr (std::is_same_v<T, byte>)
+				std::fprintf(fp, " %u", value);
+			else if constexpr (std::is_same_v<T, int16> or std::is_same_v<T, int32>)
+				std::fprintf(fp, " %d", value);
+			else if constexpr (std::is_same_v<T, float32>)
+				std::fprintf(fp, " %f", double(value));
+		}
+		std::putc('\n', fp);
+	}
+}
+
+// OBJ indices are 1-based and global to the file, counted separately for v, vt and vn
+struct ObjBases
+{
+	size_t vertex { 1 };
+	size_t texCoord { 1 };
+	size_t normal { 1 };
+};
+
+static void write_mesh(std::FILE *fp, const MeshData &data, ObjBases &bases)
+{
+	const auto numVertices = size_t(data.numVertices);
+	const auto hasNormals = bool(data.normalArray);
+	const auto hasTexCoords = bool(data.texCoordArray[0]);
+
+	if(const auto &va = data.positionArray; va)
+	{
+		// TODO: check if colors exist (should be written on the same "v" line
+		assert(va.dataType == Float32);
+		write_vertices<float32>(fp, "v", va, data.numVertices);
+	}
+	if(const auto &va = data.normalArray; va)
+	{
+		assert(va.dataType == Float32);
+		write_vertices<float32>(fp, "vn", va, data.numVertices);
+	}
+	if(const auto &va = data.texCoordArray[0]; va)
+	{
+		assert(va.dataType == Float32);
+		write_vertices<float32>(fp, "vt", va, data.numVertices);
+	}
+
+	for(const auto &segment: data.segments)
+	{
+		std::fprintf(fp, "o %s\n", segment.material.c_str());
+
+		const auto first = std::min(size_t(segment.firstIndex), data.indices.size());
+		const auto count = std::min(size_t(segment.count)*3, data.indices.size() - first);
+		for(auto idx = first; idx + 2 < first + count; idx += 3)
+		{
+			std::fputc('f', fp);
+			for(auto corner = 0u; corner < 3; ++corner)
+			{
+				const auto index = size_t(data.indices[idx + corner]);
+				const auto v = bases.vertex + index;
+				const auto vt = bases.texCoord + index;
+				const auto vn = bases.normal + index;
+				if(hasTexCoords and hasNormals)
+					std::fprintf(fp, " %zu/%zu/%zu", v, vt, vn);
+				else if(hasTexCoords)
+					std::fprintf(fp, " %zu/%zu", v, vt);
+				else if(hasNormals)
+					std::fprintf(fp, " %zu//%zu", v, vn);
+				else
+					std::fprintf(fp, " %zu", v);
+			}
+			std::fputc('\n', fp);
+		}
+	}
+
+	bases.vertex += numVertices;
+	if(hasTexCoords)
+		bases.texCoord += numVertices;
+	if(hasNormals)
+		bases.normal += numVertices;
+}
+
+// ----------------------------------------------------------------------------
+
+std::string write_obj(std::string filename, const ModelFile &model)
+{
+	auto *fp = std::fopen(filename.data(), "wb");
+	if(not fp)
+		return "FAILED: "s + std::strerror(errno);
+
+	Closer _{ fp };
+
+
+	std::fprintf(fp, "# %s\n", filename.c_str());
+
+	ObjBases bases;
+	for(const auto &node: model.nodes)
+	{
+		if(node.type != 0)
+			continue;
+
+		write_mesh(fp, node.meshEntity.value().meshData, bases);
+	}
+
+	return {};
+}
+
+// ----------------------------------------------------------------------------
+
+std::string write_obj(std::string filename, const MeshData &mesh)
+{
+	auto *fp = std::fopen(filename.data(), "wb");
+	if(not fp)
+		return "FAILED: "s + std::strerror(errno);
+
+	Closer _{ fp };
+
+	std::fprintf(fp, "# %s\n", filename.c_str());
+	ObjBases bases;
+	write_mesh(fp, mesh, bases);
+
+	return {};
+}
@@ -0,0 +1,248 @@
+#include "grobj/json.h"
+
+#include <cstdio>
+
+using namespace std::literals;
+
+// ----------------------------------------------------------------------------
+
+static void skip_space(std::string_view s, size_t &pos)
+{
+	while(pos < s.size() and (s[pos] == ' ' or s[pos] == '\t' or s[pos] == '\r' or s[pos] == '\n'))
+		++pos;
+}
+
+// ----------------------------------------------------------------------------
+
+static void utf8_append(std::string &out, unsigned cp)
+{
+	if(cp < 0x80)
+		out += char(cp);
+	else if(cp < 0x800)
+	{
+		out += char(0xc0 | (cp >> 6));
+		out += char(0x80 | (cp & 0x3f));
+	}
+	else
+	{
+		out += char(0xe0 | (cp >> 12));
+		out += char(0x80 | ((cp >> 6) & 0x3f));
+		out += char(0x80 | (cp & 0x3f));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+static bool json_string_parse(std::string_view s, size_t &pos, std::string &out)
+{
+	if(pos >= s.size() or s[pos] != '"')
+		return false;
+	++pos;
+
+	while(pos < s.size())
+	{
+		const auto ch = s[pos++];
+		if(ch == '"')
+			return true;
+		if(ch != '\\')
+		{
+			out += ch;
+			continue;
+		}
+
+		if(pos >= s.size())
+			return false;
+		switch(s[pos++])
+		{
+		case '"':  out += '"'; break;
+		case '\\': out += '\\'; break;
+		case '/':  out += '/'; break;
+		case 'b':  out += '\b'; break;
+		case 'f':  out += '\f'; break;
+		case 'n':  out += '\n'; break;
+		case 'r':  out += '\r'; break;
+		case 't':  out += '\t'; break;
+		case 'u':
+		{
+			if(pos + 4 > s.size())
+				return false;
+			unsigned cp = 0;
+			for(auto idx = 0u; idx < 4; ++idx, ++pos)
+			{
+				const auto hex = s[pos];
+				cp <<= 4;
+				if(hex >= '0' and hex <= '9')
+					cp |= unsigned(hex - '0');
+				else if(hex >= 'a' and hex <= 'f')
+					cp |= unsigned(hex - 'a' + 10);
+				else if(hex >= 'A' and hex <= 'F')
+					cp |= unsigned(hex - 'A' + 10);
+				else
+					return false;
+			}
+			utf8_append(out, cp);  // surrogate pairs are not combined
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool json_literal_valid(std::string_view token)
+{
+	if(token == "true" or token == "false" or token == "null")
+		return true;
+
+	// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+	size_t pos = 0;
+	auto digits = [&] {
+		const auto start = pos;
+		while(pos < token.size() and token[pos] >= '0' and token[pos] <= '9')
+			++pos;
+		return pos - start;
+	};
+
+	if(pos < token.size() and token[pos] == '-')
+		++pos;
+	if(pos < token.size() and token[pos] == '0')
+		++pos;
+	else if(digits() == 0)
+		return false;
+	if(pos < token.size() and token[pos] == '.')
+	{
+		++pos;
+		if(digits() == 0)
+			return false;
+	}
+	if(pos < token.size() and (token[pos] == 'e' or token[pos] == 'E'))
+	{
+		++pos;
+		if(pos < token.size() and (token[pos] == '+' or token[pos] == '-'))
+			++pos;
+		if(digits() == 0)
+			return false;
+	}
+	return pos == token.size();
+}
+
+// ----------------------------------------------------------------------------
+
+std::variant<std::string, JsonObject> json_object_parse(std::string_view s)
+{
+	JsonObject obj;
+	size_t pos = 0;
+
+	skip_space(s, pos);
+	if(pos >= s.size() or s[pos] != '{')
+		return "expected '{'"s;
+	++pos;
+
+	skip_space(s, pos);
+	const auto empty = pos < s.size() and s[pos] == '}';
+
+	while(not empty)
+	{
+		skip_space(s, pos);
+		std::string key;
+		if(not json_string_parse(s, pos, key))
+			return "expected key string"s;
+
+		skip_space(s, pos);
+		if(pos >= s.size() or s[pos] != ':')
+			return "expected ':'"s;
+		++pos;
+		skip_space(s, pos);
+
+		JsonValue value;
+		if(pos < s.size() and s[pos] == '"')
+		{
+			value.isString = true;
+			if(not json_string_parse(s, pos, value.text))
+				return "malformed string"s;
+		}
+		else
+		{
+			const auto start = pos;
+			while(pos < s.size() and s[pos] != ',' and s[pos] != '}' and s[pos] != ' ' and s[pos] != '\t' and s[pos] != '\r' and s[pos] != '\n')
+				++pos;
+			value.text = s.substr(start, pos - start);
+			if(not json_literal_valid(value.text))
+				return "unsupported value for '"s + key + "'";
+		}
+		obj[key] = std::move(value);
+
+		skip_space(s, pos);
+		if(pos >= s.size())
+			return "unterminated object"s;
+		if(s[pos] == '}')
+			break;
+		if(s[pos] != ',')
+			return "expected ',' or '}'"s;
+		++pos;
+	}
+
+	++pos;
+	skip_space(s, pos);
+	if(pos != s.size())
+		return "trailing data after '}'"s;
+
+	return obj;
+}
+
+// ----------------------------------------------------------------------------
+
+void json_escape(std::ostream &out, std::string_view s)
+{
+	out << '"';
+	for(const auto ch: s)
+	{
+		switch(ch)
+		{
+		case '"':  out << "\\\""; break;
+		case '\\': out << "\\\\"; break;
+		case '\n': out << "\\n"; break;
+		case '\r': out << "\\r"; break;
+		case '\t': out << "\\t"; break;
+		default:
+			if(static_cast<unsigned char>(ch) < 0x20)
+			{
+				char buf[8];
+				std::snprintf(buf, sizeof(buf), "\\u%04x", unsigned(ch));
+				out << buf;
+			}
+			else
+				out << ch;
+		}
+	}
+	out << '"';
+}
+
+// ----------------------------------------------------------------------------
+
+void json_vec3(std::ostream &out, const Vec3 &v)
+{
+	out << '[' << v.x << ',' << v.y << ',' << v.z << ']';
+}
+
+// ----------------------------------------------------------------------------
+
+bool json_bool(const JsonObject &obj, const char *key)
+{
+	auto found = obj.find(key);
+	return found != obj.end() and not found->second.isString and found->second.text == "true";
+}
+
+// ----------------------------------------------------------------------------
+
+std::string json_string(const JsonObject &obj, const char *key)
+{
+	auto found = obj.find(key);
+	if(found == obj.end() or not found->second.isString)
+		return {};
+	return found->second.text;
+}
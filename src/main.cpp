@@ -1,5 +1,6 @@
 // An attempt at reading/convert GrimRock .model files
 
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
@@ -7,17 +8,24 @@
 using namespace std::chrono;
 #include <assert.h>
 #include <filesystem>
+#include <optional>
 #include <variant>
 namespace fs = std::filesystem;
 
 #include "grobj/grimrock.h"
+#include "grobj/archive.h"
+#include "grobj/batch.h"
+#include "grobj/dedup.h"
 #include "grobj/dump.h"
+#include "grobj/io.h"
+#include "grobj/meshlets.h"
+#include "grobj/serve.h"
+#include "grobj/tangents.h"
+#include "grobj/thread_pool.h"
+#include "grobj/watch.h"
 
 using namespace std::literals;
 
-std::variant<std::string, ModelFile> read_model(std::string_view filename);
-std::string write_obj(std::string filename, const ModelFile &model);
-
 // ----------------------------------------------------------------------------
 
 
@@ -33,7 +41,31 @@ int main(int argc, char *argv[])
 		out << "  -E, --include-empty     Dump also empty nodes\n";
 		out << "  -B, --include-bones     Dump also bones\n";
 		out << "  -M, --transforms        Dump transforms of various entries\n";
+		out << "  -g, --generate-tangents Generate missing normals, tangents and bitangents before any\n";
+		out << "                            output (not with --serve)\n";
+		out << "      --angle-weighted    Weight generated normals by corner angle (default: by area)\n";
+		out << "      --verify-tangents   Compare generated tangent space against the reference implementation\n";
 		out << "  -o, --output NAME       Write Wavefront OBJ to NAME.obj\n";
+		out << "      --meshlets          Also write meshlets (for mesh shaders) to NAME.meshlets; needs --output,\n";
+		out << "                            not with -m\n";
+		out << "  -m, --merge-materials   Merge all segments sharing a material into one object\n";
+		out << "  -a, --archive FILE.dat  Read models from a Grimrock asset archive; <name.model> arguments\n";
+		out << "                            name entries (by path or \"#<hash>\"), default is all models,\n";
+		out << "                            and --output names a directory\n";
+		out << "      --list              List the entries of the archive\n";
+		out << "      --dedup DIR         Write each distinct mesh of all inputs once to DIR,\n";
+		out << "                            with a manifest of where they are instanced\n";
+		out << "      --serve             Serve newline-delimited JSON requests (see below)\n";
+		out << "      --socket PATH       Serve on Unix socket PATH instead of stdin/stdout\n";
+		out << "      --watch DIR         Convert changed .model files under DIR, and keep watching it\n";
+		out << "      --output-dir DIR    Where --watch writes its output (default: next to the inputs)\n";
+		out << "      --debounce MS       Quiet period before --watch processes changes (default: 200)\n";
+		out << "      --threads N         Number of worker threads (default: all cores)\n";
+		out << "      --cache-size MB     Memory budget of the parsed-model cache (default: 256)\n";
+		out << "Server requests are JSON objects, one per line, e.g.:\n";
+		out << "  {\"id\": 1, \"cmd\": \"dump\", \"file\": \"a.model\", \"empty\": true, \"bones\": true}\n";
+		out << "  commands: info, dump, bounds, find (\"node\": NAME and/or \"material\": NAME),\n";
+		out << "            convert (\"output\": NAME), stats, shutdown\n";
 
 		std::exit(exit_code);
 	};
@@ -44,6 +76,19 @@ int main(int argc, char *argv[])
 	bool opt_dumpInfo = false;
 	Filter dumpFilter { 0 };
 	std::string output_file;
+	bool opt_mergeMaterials = false;
+	bool opt_meshlets = false;
+	bool opt_generateTangents = false;
+	bool opt_verifyTangents = false;
+	NormalWeighting normalWeighting = NormalWeighting::Area;
+	std::string dedup_dir;
+	std::string archive_file;
+	bool opt_list = false;
+	bool opt_serve = false;
+	ServeOptions serveOpts { {}, 0, 256 << 20 };
+	bool opt_watch = false;
+	WatchOptions watchOpts { {}, {}, 0, 200, false, NormalWeighting::Area };
+	size_t opt_threads = 0;
 
 	std::vector<std::string_view> filenames;
 
@@ -61,11 +106,83 @@ int main(int argc, char *argv[])
 				print_usage();
 			output_file = argv[idx];
 		}
+		else if(arg == "-a"sv or arg == "--archive"sv)
+		{
+			++idx;
+			if(idx >= argc)
+				print_usage();
+			archive_file = argv[idx];
+		}
+		else if(arg == "--list"sv)
+			opt_list = true;
+		else if(arg == "--dedup"sv)
+		{
+			++idx;
+			if(idx >= argc)
+				print_usage();
+			dedup_dir = argv[idx];
+		}
+		else if(arg == "--serve"sv)
+			opt_serve = true;
+		else if(arg == "--socket"sv)
+		{
+			++idx;
+			if(idx >= argc)
+				print_usage();
+			opt_serve = true;
+			serveOpts.socketPath = argv[idx];
+		}
+		else if(arg == "--threads"sv)
+		{
+			++idx;
+			if(idx >= argc)
+				print_usage();
+			opt_threads = std::strtoul(argv[idx], nullptr, 10);
+		}
+		else if(arg == "--watch"sv)
+		{
+			++idx;
+			if(idx >= argc)
+				print_usage();
+			opt_watch = true;
+			watchOpts.inputDir = argv[idx];
+		}
+		else if(arg == "--output-dir"sv)
+		{
+			++idx;
+			if(idx >= argc)
+				print_usage();
+			watchOpts.outputDir = argv[idx];
+		}
+		else if(arg == "--debounce"sv)
+		{
+			++idx;
+			if(idx >= argc)
+				print_usage();
+			watchOpts.debounceMs = unsigned(std::strtoul(argv[idx], nullptr, 10));
+		}
+		else if(arg == "--cache-size"sv)
+		{
+			++idx;
+			if(idx >= argc)
+				print_usage();
+			serveOpts.cacheBytes = std::strtoul(argv[idx], nullptr, 10) << 20;
+		}
+		else if(arg == "-g"sv or arg == "--generate-tangents"sv)
+			opt_generateTangents = true;
+		else if(arg == "--angle-weighted"sv)
+			normalWeighting = NormalWeighting::Angle;
+		else if(arg == "--verify-tangents"sv)
+			opt_verifyTangents = true;
+		else if(arg == "--meshlets"sv)
+			opt_meshlets = true;
+		else if(arg == "-m"sv or arg == "--merge-materials"sv)
+			opt_mergeMaterials = true;
 		else if(arg == "-E"sv or arg == "--include-empty"sv)
 			dumpFilter |= includeEmptyNodes;
-		else if(arg == "-B" or arg == "--include-bones"sv)
+		else if(arg == "-B"sv or arg == "--include-bones"sv)
 			dumpFilter |= includeBones;
-		else if(arg == "-M" or arg == "--transforms"sv)
+		else if(arg == "-M"sv or arg == "--transforms"sv)
 			dumpFilter |= includeTransforms;
 		else
 			return false;
@@ -87,6 +204,55 @@ int main(int argc, char *argv[])
 			filenames.push_back(std::string_view{ argv[idx], std::strlen(argv[idx]) });
 	}
 
+	if(opt_serve and opt_generateTangents)
+	{
+		// the server's cached models are shared between requests, and never modified
+		std::cerr << "-g/--generate-tangents is not supported with --serve\n";
+		return 1;
+	}
+	if(opt_meshlets and (output_file.empty() or opt_mergeMaterials or opt_serve or opt_watch or not dedup_dir.empty()))
+	{
+		// meshlets index the per-node vertex arrays, which -m replaces in the OBJ
+		std::cerr << "--meshlets needs --output, and is not supported with -m, --serve, --watch or --dedup\n";
+		return 1;
+	}
+
+	if(opt_serve)
+	{
+		serveOpts.numThreads = opt_threads;
+		return serve(serveOpts);
+	}
+	if(opt_watch)
+	{
+		watchOpts.numThreads = opt_threads;
+		watchOpts.generateTangents = opt_generateTangents;
+		watchOpts.normalWeighting = normalWeighting;
+		return watch(watchOpts);
+	}
+	if(not archive_file.empty())
+	{
+		ArchiveOptions archiveOpts {
+			archive_file,
+			{ filenames.begin(), filenames.end() },
+			opt_list,
+			opt_dumpInfo,
+			dumpFilter,
+			output_file,
+			opt_mergeMaterials,
+			opt_meshlets,
+			opt_generateTangents,
+			normalWeighting,
+			opt_threads,
+		};
+		return process_archive(archiveOpts);
+	}
+	if(not dedup_dir.empty())
+		return dedup({ filenames.begin(), filenames.end() }, { dedup_dir, opt_threads, opt_generateTangents, normalWeighting });
+
+	std::optional<ThreadPool> pool;
+	if(opt_generateTangents or opt_verifyTangents or opt_meshlets)
+		pool.emplace(opt_threads);
+
 	for(const auto &filename: filenames)
 	{
 		const auto T0 = steady_clock::now();
@@ -98,19 +264,64 @@ int main(int argc, char *argv[])
 		{
 			const auto T1 = steady_clock::now();
 
-			const auto &model = std::get<ModelFile>(model_);
+			auto &model = std::get<ModelFile>(model_);
 
 			std::cout << "[" << path.filename().generic_string() << "] read " << model.nodes.size() << " nodes  (" << duration_cast<microseconds>(T1 - T0).count() << " µs):\n";
+
+			if(opt_verifyTangents)
+				verify_tangent_space(model, normalWeighting, &pool.value(), std::cout);
+			if(opt_generateTangents)
+			{
+				const auto T0 = steady_clock::now();
+				const auto generated = generate_tangent_space(model, normalWeighting, &pool.value());
+				const auto T1 = steady_clock::now();
+
+				std::cout << "[" << path.filename().generic_string() << "] generated " << generated.arrays << " vertex arrays";
+				if(generated.splitVertices)
+					std::cout << ", split " << generated.splitVertices << " vertices at mirrored uv seams";
+				std::cout << "  (" << duration_cast<microseconds>(T1 - T0).count() << " µs)\n";
+			}
 			if(opt_dumpInfo)
 				dump(model, std::cout, dumpFilter);
 
 			if(not output_file.empty())
 			{
 				const auto T0 = steady_clock::now();
-				write_obj(output_file, model);
+				if(opt_mergeMaterials)
+				{
+					const auto batches = batch_by_material(model);
+					write_obj(output_file, batches);
+					std::cout << "[" << path.filename().generic_string() << "] draw calls: " << draw_calls(model) << " -> " << batches.size() << '\n';
+				}
+				else
+					write_obj(output_file, model);
 				const auto T1 = steady_clock::now();
 
 				std::cout << "[" << path.filename().generic_string() << "] wrote Wavefront OBJ: " << output_file << "  (" << duration_cast<microseconds>(T1 - T0).count() << " µs)\n";
+
+				if(opt_meshlets)
+				{
+					const auto T0 = steady_clock::now();
+					const auto meshlets = build_meshlets(model, &pool.value());
+					const auto meshletFile = fs::path(output_file).replace_extension(".meshlets").string();
+					const auto error = write_meshlets(meshletFile, meshlets);
+					const auto T1 = steady_clock::now();
+
+					if(not error.empty())
+						std::cerr << "[" << path.filename().generic_string() << "] " << meshletFile << ": " << error << '\n';
+					else
+					{
+						size_t count = 0;
+						for(const auto &set: meshlets)
+							count += set.meshlets.size();
+						double vertexFill, triangleFill;
+						meshlet_fill(meshlets, vertexFill, triangleFill);
+
+						std::cout << "[" << path.filename().generic_string() << "] wrote " << count << " meshlets: " << meshletFile
+							<< "  (fill: vertices " << int(vertexFill*100) << "%, triangles " << int(triangleFill*100) << "%)  ("
+							<< duration_cast<microseconds>(T1 - T0).count() << " µs)\n";
+					}
+				}
 			}
 		}
 		else
@@ -119,97 +330,3 @@ int main(int argc, char *argv[])
 
 	return 0;
 }
-
-// ----------------------------------------------------------------------------
-
-struct Closer
-{
-	~Closer() { std::fclose(fp); }
-	std::FILE *fp;
-};
-
-std::variant<std::string, ModelFile> read_model(std::string_view filename)
-{
-	auto *fp = std::fopen(filename.data(), "rb");
-	if(not fp)
-		return "FAILED: "s + std::strerror(errno);
-
-	Closer _{ fp };
-
-	return ModelFile::read(fp);
-}
-
-// ----------------------------------------------------------------------------
-
-template<typename T>
-void write_vertices(std::FILE *fp, const char *vtype, const VertexArray &va, int32 numVertices)
-{
-	const T *arrData = reinterpret_cast<const T *>(va.rawVertexData.data());
-	for(auto idx = 0; idx < numVertices*va.dim; ++idx)
-	{
-		std::fputs(vtype, fp);
-		for(auto comp = 0; comp < va.dim; ++comp, ++idx)
-		{
-			if constexpr (std::is_same_v<T, byte>)
-				std::fprintf(fp, " %u", arrData[idx]);
-			else if constexpr (std::is_same_v<T, int16> or std::is_same_v<T, int32>)
-				std::fprintf(fp, " %d", arrData[idx]);
-			else if constexpr (std::is_same_v<T, float32>)
-				std::fprintf(fp, " %f", arrData[idx]);
-		}
-		std::putc('\n', fp);
-	}
-}
-
-
-std::string write_obj(std::string filename, const ModelFile &model)
-{
-	auto *fp = std::fopen(filename.data(), "wb");
-	if(not fp)
-		return "FAILED: "s + std::strerror(errno);
-
-	Closer _{ fp };
-
-
-	std::fprintf(fp, "# %s\n", filename.c_str());
-
-	for(const auto &node: model.nodes)
-	{
-		if(node.type != 0)
-			continue;
-
-		const auto &data = node.meshEntity.value().meshData;
-
-		if(const auto &va = data.positionArray; va)
-		{
-			// TODO: check if colors exist (should be written on the same "v" line
-			assert(va.dataType == Float32);
-			write_vertices<float32>(fp, "v", va, data.numVertices);
-		}
-		if(const auto &va = data.normalArray; va)
-		{
-			assert(va.dataType == Float32);
-			write_vertices<float32>(fp, "vn", va, data.numVertices);
-		}
-		if(const auto &va = data.texCoordArray[0]; va)
-		{
-			assert(va.dataType == Float32);
-			write_vertices<float32>(fp, "vt", va, data.numVertices);
-		}
-
-		for(const auto &segment: data.segments)
-		{
-			std::fprintf(fp, "o %s\n", segment.material.c_str());
-			for(auto tri = 0u; tri < size_t(segment.count); ++tri)
-			{
-				std::fprintf(fp, "f %d %d %d\n",
-							 data.indices[tri*3],
-							 data.indices[tri*3 + 1],
-							 data.indices[tri*3 + 2]
-				);
-			}
-		}
-	}
-
-	return {};
-}
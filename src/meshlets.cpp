@@ -0,0 +1,401 @@
+#include "grobj/meshlets.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "grobj/io.h"
+#include "grobj/math.h"
+#include "grobj/thread_pool.h"
+
+using namespace std::literals;
+
+// unconnected triangles considered when a meshlet can't grow any further
+static constexpr unsigned fallbackCandidates { 32 };
+
+
+// ----------------------------------------------------------------------------
+
+// Spread the low 10 bits of 'v' to every third bit.
+static std::uint32_t morton_spread(std::uint32_t v)
+{
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// ----------------------------------------------------------------------------
+
+static void finish_meshlet(MeshletSet &set, const MeshData &md, const std::vector<std::uint32_t> &verts, const std::vector<std::uint8_t> &tris)
+{
+	Meshlet m;
+	m.vertexOffset = std::uint32_t(set.vertices.size());
+	m.triangleOffset = std::uint32_t(set.triangles.size() / 3);
+	m.vertexCount = std::uint8_t(verts.size());
+	m.triangleCount = std::uint8_t(tris.size() / 3);
+
+	// bounding sphere around the box center
+	constexpr auto inf = std::numeric_limits<float32>::infinity();
+	Vec3 bmin { inf, inf, inf };
+	Vec3 bmax { -inf, -inf, -inf };
+	for(const auto v: verts)
+	{
+		const auto p = read_vec3(md.positionArray, v);
+		bmin = { std::min(bmin.x, p.x), std::min(bmin.y, p.y), std::min(bmin.z, p.z) };
+		bmax = { std::max(bmax.x, p.x), std::max(bmax.y, p.y), std::max(bmax.z, p.z) };
+	}
+	m.center = (bmin + bmax)*0.5f;
+	m.radius = 0;
+	for(const auto v: verts)
+		m.radius = std::max(m.radius, length(read_vec3(md.positionArray, v) - m.center));
+
+	// normal cone, following meshoptimizer's conventions
+	Vec3 normals[maxMeshletTriangles];
+	Vec3 corners[maxMeshletTriangles];
+	Vec3 axis { 0, 0, 0 };
+	size_t numNormals = 0;
+	for(auto idx = 0u; idx < tris.size(); idx += 3)
+	{
+		const auto p0 = read_vec3(md.positionArray, verts[tris[idx]]);
+		const auto p1 = read_vec3(md.positionArray, verts[tris[idx + 1]]);
+		const auto p2 = read_vec3(md.positionArray, verts[tris[idx + 2]]);
+		const auto n = cross(p1 - p0, p2 - p0);
+		if(length(n) == 0)
+			continue;
+		normals[numNormals] = normalize(n);
+		corners[numNormals] = p0;
+		axis = axis + normals[numNormals];
+		++numNormals;
+	}
+	axis = normalize(axis);
+
+	auto minDot = 1.f;
+	for(auto idx = 0u; idx < numNormals; ++idx)
+		minDot = std::min(minDot, dot(axis, normals[idx]));
+
+	m.coneAxis = axis;
+	m.coneApex = m.center;
+	m.coneCutoff = 1;
+	if(numNormals > 0 and minDot > 0.1f)  // otherwise, wider than ~84°; never culled
+	{
+		// move the apex back until every triangle plane is in front of it
+		auto maxT = 0.f;
+		for(auto idx = 0u; idx < numNormals; ++idx)
+		{
+			const auto dc = dot(m.center - corners[idx], normals[idx]);
+			const auto dn = dot(axis, normals[idx]);
+			maxT = std::max(maxT, dc / dn);
+		}
+		m.coneApex = m.center - axis*maxT;
+		m.coneCutoff = std::sqrt(1 - minDot*minDot);
+	}
+
+	set.meshlets.push_back(m);
+	set.vertices.insert(set.vertices.end(), verts.begin(), verts.end());
+	set.triangles.insert(set.triangles.end(), tris.begin(), tris.end());
+}
+
+// ----------------------------------------------------------------------------
+
+MeshletSet build_meshlets(const MeshData &md, const MeshSegment &segment)
+{
+	MeshletSet set { -1, -1, {}, {}, {} };
+
+	if(not usable(md.positionArray, 3) or segment.firstIndex < 0 or segment.count <= 0)
+		return set;
+
+	const auto numVertices = size_t(md.numVertices);
+	const auto first = size_t(segment.firstIndex);
+	const auto last = std::min(md.indices.size(), first + size_t(segment.count)*3);
+
+	// the segment's valid triangles, and their centroids
+	std::vector<std::uint32_t> corners;
+	corners.reserve(last > first? last - first: 0);
+	for(auto idx = first; idx + 2 < last; idx += 3)
+	{
+		const auto a = md.indices[idx], b = md.indices[idx + 1], c = md.indices[idx + 2];
+		if(a < 0 or b < 0 or c < 0 or a >= md.numVertices or b >= md.numVertices or c >= md.numVertices)
+			continue;
+		corners.insert(corners.end(), { std::uint32_t(a), std::uint32_t(b), std::uint32_t(c) });
+	}
+	const auto numTriangles = corners.size() / 3;
+	if(numTriangles == 0)
+		return set;
+
+	std::vector<Vec3> centroids(numTriangles);
+	constexpr auto inf = std::numeric_limits<float32>::infinity();
+	Vec3 bmin { inf, inf, inf };
+	Vec3 bmax { -inf, -inf, -inf };
+	for(auto tri = 0u; tri < numTriangles; ++tri)
+	{
+		const auto c = (read_vec3(md.positionArray, corners[tri*3]) + read_vec3(md.positionArray, corners[tri*3 + 1]) + read_vec3(md.positionArray, corners[tri*3 + 2]))*(1.f/3);
+		centroids[tri] = c;
+		bmin = { std::min(bmin.x, c.x), std::min(bmin.y, c.y), std::min(bmin.z, c.z) };
+		bmax = { std::max(bmax.x, c.x), std::max(bmax.y, c.y), std::max(bmax.z, c.z) };
+	}
+
+	// seeds are taken in Morton order, so a new meshlet starts close to the previous one
+	std::vector<std::uint32_t> order(numTriangles);
+	{
+		std::vector<std::uint32_t> codes(numTriangles);
+		const auto extent = bmax - bmin;
+		const auto scale = [](float32 e) { return e > 0? 1023/e: 0.f; };
+		const Vec3 s { scale(extent.x), scale(extent.y), scale(extent.z) };
+		for(auto tri = 0u; tri < numTriangles; ++tri)
+		{
+			const auto q = centroids[tri] - bmin;
+			codes[tri] = morton_spread(std::uint32_t(q.x*s.x)) | morton_spread(std::uint32_t(q.y*s.y)) << 1 | morton_spread(std::uint32_t(q.z*s.z)) << 2;
+			order[tri] = tri;
+		}
+		std::sort(order.begin(), order.end(), [&codes](auto a, auto b) { return codes[a] < codes[b]; });
+	}
+
+	// vertex -> triangles adjacency
+	std::vector<std::uint32_t> adjOffsets(numVertices + 1, 0);
+	for(const auto v: corners)
+		++adjOffsets[v + 1];
+	for(auto idx = 0u; idx < numVertices; ++idx)
+		adjOffsets[idx + 1] += adjOffsets[idx];
+	std::vector<std::uint32_t> adjacency(corners.size());
+	{
+		auto fill = adjOffsets;
+		for(auto idx = 0u; idx < corners.size(); ++idx)
+			adjacency[fill[corners[idx]]++] = std::uint32_t(idx / 3);
+	}
+
+	// number of unused triangles around each vertex
+	std::vector<std::uint32_t> live(numVertices, 0);
+	for(const auto v: corners)
+		++live[v];
+
+	std::vector<bool> used(numTriangles, false);
+	std::vector<std::int16_t> slot(numVertices, -1);  // vertex's index in the current meshlet
+	std::vector<std::uint32_t> verts;
+	std::vector<std::uint8_t> tris;
+	verts.reserve(maxMeshletVertices);
+	tris.reserve(maxMeshletTriangles*3);
+	Vec3 centroidSum { 0, 0, 0 };
+	size_t seedCursor = 0;
+
+	auto flush = [&] {
+		finish_meshlet(set, md, verts, tris);
+		for(const auto v: verts)
+			slot[v] = -1;
+		verts.clear();
+		tris.clear();
+		centroidSum = { 0, 0, 0 };
+	};
+
+	for(auto remaining = numTriangles; remaining > 0; )
+	{
+		// greedily grow: prefer the neighbouring triangle adding the fewest new vertices,
+		//   then the one using up most of its vertices' remaining triangles (keeps the
+		//   border of what's left short), then the one closest to the meshlet's center
+		auto best = numTriangles;
+		auto bestNew = 4u;
+		auto bestLive = std::numeric_limits<std::uint32_t>::max();
+		auto bestDist = inf;
+		const auto center = tris.empty()? Vec3{ 0, 0, 0 }: centroidSum*(3.f/float32(tris.size()));
+
+		auto consider = [&](std::uint32_t tri) {
+			auto newVerts = 0u;
+			auto liveSum = 0u;
+			for(auto corner = 0u; corner < 3; ++corner)
+			{
+				const auto v = corners[tri*3 + corner];
+				newVerts += slot[v] < 0? 1: 0;
+				liveSum += live[v];
+			}
+			if(verts.size() + newVerts > maxMeshletVertices)
+				return;
+
+			const auto d = centroids[tri] - center;
+			const auto dist = dot(d, d);
+			if(newVerts < bestNew or (newVerts == bestNew and (liveSum < bestLive or (liveSum == bestLive and dist < bestDist))))
+			{
+				best = tri;
+				bestNew = newVerts;
+				bestLive = liveSum;
+				bestDist = dist;
+			}
+		};
+
+		for(const auto v: verts)
+		{
+			for(auto adj = adjOffsets[v]; adj < adjOffsets[v + 1]; ++adj)
+			{
+				if(not used[adjacency[adj]])
+					consider(adjacency[adj]);
+			}
+		}
+
+		if(best == numTriangles)
+		{
+			while(used[order[seedCursor]])
+				++seedCursor;
+
+			if(tris.empty())
+				best = order[seedCursor];
+			else
+			{
+				// nothing connected fits; try the next few unused triangles nearby in Morton order
+				auto tried = 0u;
+				for(auto idx = seedCursor; idx < numTriangles and tried < fallbackCandidates; ++idx)
+				{
+					if(used[order[idx]])
+						continue;
+					consider(order[idx]);
+					++tried;
+				}
+				if(best == numTriangles)
+				{
+					flush();
+					continue;
+				}
+			}
+		}
+
+		for(auto corner = 0u; corner < 3; ++corner)
+		{
+			const auto v = corners[best*3 + corner];
+			if(slot[v] < 0)
+			{
+				slot[v] = std::int16_t(verts.size());
+				verts.push_back(v);
+			}
+			tris.push_back(std::uint8_t(slot[v]));
+		}
+		for(auto corner = 0u; corner < 3; ++corner)
+			--live[corners[best*3 + corner]];
+		centroidSum = centroidSum + centroids[best];
+		used[best] = true;
+		--remaining;
+
+		if(tris.size() == maxMeshletTriangles*3)
+			flush();
+	}
+	if(not tris.empty())
+		flush();
+
+	return set;
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<MeshletSet> build_meshlets(const ModelFile &model, ThreadPool *pool)
+{
+	std::vector<MeshletSet> sets;
+	for(auto nodeIdx = 0u; nodeIdx < model.nodes.size(); ++nodeIdx)
+	{
+		const auto &node = model.nodes[nodeIdx];
+		if(not node.meshEntity)
+			continue;
+		const auto &md = node.meshEntity.value().meshData;
+		for(auto segIdx = 0u; segIdx < md.segments.size(); ++segIdx)
+			sets.push_back({ int32(nodeIdx), int32(segIdx), {}, {}, {} });
+	}
+
+	// one task per segment
+	parallel_blocks(pool, sets.size(), sets.size(), [&](size_t idx, size_t, size_t) {
+		auto &set = sets[idx];
+		const auto &md = model.nodes[size_t(set.node)].meshEntity.value().meshData;
+		auto built = build_meshlets(md, md.segments[size_t(set.segment)]);
+		set.meshlets = std::move(built.meshlets);
+		set.vertices = std::move(built.vertices);
+		set.triangles = std::move(built.triangles);
+	});
+
+	return sets;
+}
+
+// ----------------------------------------------------------------------------
+
+void meshlet_fill(const std::vector<MeshletSet> &sets, double &vertexFill, double &triangleFill)
+{
+	size_t count = 0;
+	double vertices = 0;
+	double triangles = 0;
+	for(const auto &set: sets)
+	{
+		for(const auto &m: set.meshlets)
+		{
+			vertices += double(m.vertexCount) / maxMeshletVertices;
+			triangles += double(m.triangleCount) / maxMeshletTriangles;
+			++count;
+		}
+	}
+
+	vertexFill = count? vertices/double(count): 0;
+	triangleFill = count? triangles/double(count): 0;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T>
+static void append(std::vector<byte> &out, const T &value)
+{
+	const auto *bytes = reinterpret_cast<const byte *>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// ----------------------------------------------------------------------------
+
+static void append(std::vector<byte> &out, const Vec3 &v)
+{
+	append(out, v.x);
+	append(out, v.y);
+	append(out, v.z);
+}
+
+// ----------------------------------------------------------------------------
+
+std::string write_meshlets(std::string filename, const std::vector<MeshletSet> &sets)
+{
+	auto *fp = std::fopen(filename.data(), "wb");
+	if(not fp)
+		return "FAILED: "s + std::strerror(errno);
+
+	Closer _{ fp };
+
+	std::vector<byte> out;
+	out.insert(out.end(), { 'M', 'S', 'H', 'L' });
+	append(out, int32(1));
+	append(out, int32(sets.size()));
+
+	for(const auto &set: sets)
+	{
+		append(out, set.node);
+		append(out, set.segment);
+		append(out, int32(set.meshlets.size()));
+		append(out, int32(set.vertices.size()));
+		append(out, int32(set.triangles.size() / 3));
+
+		for(const auto &m: set.meshlets)
+		{
+			append(out, m.vertexOffset);
+			append(out, m.triangleOffset);
+			append(out, m.vertexCount);
+			append(out, m.triangleCount);
+			append(out, std::uint16_t(0));
+			append(out, m.center);
+			append(out, m.radius);
+			append(out, m.coneApex);
+			append(out, m.coneAxis);
+			append(out, m.coneCutoff);
+		}
+
+		const auto *vertices = reinterpret_cast<const byte *>(set.vertices.data());
+		out.insert(out.end(), vertices, vertices + set.vertices.size()*sizeof(std::uint32_t));
+		out.insert(out.end(), set.triangles.begin(), set.triangles.end());
+	}
+
+	if(std::fwrite(out.data(), 1, out.size(), fp) != out.size())
+		return "FAILED: short write";
+
+	return {};
+}
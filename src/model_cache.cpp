@@ -0,0 +1,149 @@
+#include "grobj/model_cache.h"
+
+#include <stdexcept>
+
+#include "grobj/io.h"
+
+namespace fs = std::filesystem;
+using namespace std::literals;
+
+// ----------------------------------------------------------------------------
+
+static size_t memory_size(const VertexArray &va)
+{
+	return va.rawVertexData.capacity();
+}
+
+// ----------------------------------------------------------------------------
+
+size_t memory_size(const ModelFile &mf)
+{
+	size_t bytes = sizeof(ModelFile) + mf.nodes.capacity()*sizeof(Node);
+
+	for(const auto &node: mf.nodes)
+	{
+		bytes += node.name.capacity();
+
+		if(not node.meshEntity)
+			continue;
+
+		const auto &me = node.meshEntity.value();
+		const auto &md = me.meshData;
+
+		bytes += me.bones.capacity()*sizeof(Bone);
+		bytes += md.indices.capacity()*sizeof(int32);
+		bytes += md.segments.capacity()*sizeof(MeshSegment);
+		for(const auto &seg: md.segments)
+			bytes += seg.material.capacity();
+
+		for(const auto *va: { &md.positionArray, &md.normalArray, &md.tangentArray, &md.bitangentArray, &md.colorArray, &md.boneArray, &md.boneWeightArray })
+			bytes += memory_size(*va);
+		for(const auto &va: md.texCoordArray)
+			bytes += memory_size(va);
+	}
+
+	return bytes;
+}
+
+// ----------------------------------------------------------------------------
+
+ModelCache::ModelCache(size_t maxBytes) :
+	_maxBytes(maxBytes)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+std::variant<std::string, ModelCache::Model> ModelCache::get(const std::string &filename, bool &hit)
+{
+	hit = false;
+
+	std::error_code ec;
+	const auto fileSize = fs::file_size(filename, ec);
+	if(ec)
+		return "FAILED: " + ec.message();
+	const auto mtime = fs::last_write_time(filename, ec);
+	if(ec)
+		return "FAILED: " + ec.message();
+
+	{
+		std::unique_lock lock(_mutex);
+
+		if(auto found = _index.find(filename); found != _index.end())
+		{
+			auto entry = found->second;
+			if(entry->fileSize == fileSize and entry->mtime == mtime)
+			{
+				_lru.splice(_lru.begin(), _lru, entry);
+				++_hits;
+				hit = true;
+				return entry->model;
+			}
+
+			// stale; drop it and reload below
+			_bytes -= entry->bytes;
+			_index.erase(found);
+			_lru.erase(entry);
+		}
+		++_misses;
+	}
+
+	// parse without holding the lock; concurrent misses on the same file
+	//   may both parse it, the last one to finish wins the cache slot
+	std::variant<std::string, ModelFile> model_;
+	try
+	{
+		model_ = read_model(filename);
+	}
+	catch(const std::exception &e)
+	{
+		return "FAILED: "s + e.what();
+	}
+	if(std::holds_alternative<std::string>(model_))
+		return std::get<std::string>(model_);
+
+	auto model = std::make_shared<const ModelFile>(std::move(std::get<ModelFile>(model_)));
+	const auto bytes = memory_size(*model);
+
+	std::unique_lock lock(_mutex);
+
+	if(auto found = _index.find(filename); found != _index.end())
+	{
+		auto entry = found->second;
+		_bytes -= entry->bytes;
+		_index.erase(found);
+		_lru.erase(entry);
+	}
+
+	_lru.push_front(Entry{ filename, fileSize, mtime, bytes, model });
+	_index.emplace(_lru.front().filename, _lru.begin());
+	_bytes += bytes;
+
+	evict_locked();
+
+	return model;
+}
+
+// ----------------------------------------------------------------------------
+
+ModelCache::Stats ModelCache::stats() const
+{
+	std::unique_lock lock(_mutex);
+
+	return { _lru.size(), _bytes, _hits, _misses, _evictions };
+}
+
+// ----------------------------------------------------------------------------
+
+void ModelCache::evict_locked()
+{
+	// always keep the most recent entry, even if it alone exceeds the budget
+	while(_bytes > _maxBytes and _lru.size() > 1)
+	{
+		auto &victim = _lru.back();
+		_bytes -= victim.bytes;
+		_index.erase(victim.filename);
+		_lru.pop_back();
+		++_evictions;
+	}
+}
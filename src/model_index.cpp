@@ -0,0 +1,113 @@
+#include "grobj/model_index.h"
+
+
+// ----------------------------------------------------------------------------
+
+NameId StringTable::intern(std::string_view s)
+{
+	if(auto found = _ids.find(s); found != _ids.end())
+		return found->second;
+
+	const auto id = NameId(_strings.size());
+	_strings.emplace_back(s);
+	_ids.emplace(_strings.back(), id);
+
+	return id;
+}
+
+// ----------------------------------------------------------------------------
+
+NameId StringTable::find(std::string_view s) const
+{
+	auto found = _ids.find(s);
+	return found == _ids.end()? noName: found->second;
+}
+
+// ----------------------------------------------------------------------------
+
+ModelIndex::ModelIndex(const ModelFile &model, std::shared_ptr<StringTable> names) :
+	_names(names? std::move(names): std::make_shared<StringTable>())
+{
+	const auto numNodes = model.nodes.size();
+
+	_nodeNames.reserve(numNodes);
+	_nodeByName.reserve(numNodes);
+	_childOffsets.assign(numNodes + 1, 0);
+
+	for(auto idx = 0u; idx < numNodes; ++idx)
+	{
+		const auto &node = model.nodes[idx];
+
+		const auto name = _names->intern(node.name);
+		_nodeNames.push_back(name);
+		_nodeByName.try_emplace(name, int32(idx));
+
+		if(node.parent >= 0 and size_t(node.parent) < numNodes)
+			++_childOffsets[size_t(node.parent) + 1];
+		else
+			_roots.push_back(int32(idx));
+
+		if(not node.meshEntity)
+			continue;
+
+		const auto &segments = node.meshEntity.value().meshData.segments;
+		for(auto seg = 0u; seg < segments.size(); ++seg)
+		{
+			const auto material = _names->intern(segments[seg].material);
+			auto [found, inserted] = _segmentsByMaterial.try_emplace(material);
+			if(inserted)
+				_materials.push_back(material);
+			found->second.push_back({ int32(idx), int32(seg) });
+		}
+	}
+
+	// children, bucketed per parent (counted above)
+	for(auto idx = 0u; idx < numNodes; ++idx)
+		_childOffsets[idx + 1] += _childOffsets[idx];
+
+	_children.resize(size_t(_childOffsets[numNodes]));
+	auto fill = _childOffsets;
+	for(auto idx = 0u; idx < numNodes; ++idx)
+	{
+		const auto parent = model.nodes[idx].parent;
+		if(parent >= 0 and size_t(parent) < numNodes)
+			_children[size_t(fill[size_t(parent)]++)] = int32(idx);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+int32 ModelIndex::find_node(std::string_view name) const
+{
+	const auto id = _names->find(name);
+	if(id == noName)
+		return -1;
+
+	auto found = _nodeByName.find(id);
+	return found == _nodeByName.end()? -1: found->second;
+}
+
+// ----------------------------------------------------------------------------
+
+ModelIndex::Children ModelIndex::children(int32 node) const
+{
+	const auto *data = _children.data();
+	return { data + _childOffsets[size_t(node)], data + _childOffsets[size_t(node) + 1] };
+}
+
+// ----------------------------------------------------------------------------
+
+const std::vector<SegmentRef> &ModelIndex::segments(NameId material) const
+{
+	static const std::vector<SegmentRef> none;
+
+	auto found = _segmentsByMaterial.find(material);
+	return found == _segmentsByMaterial.end()? none: found->second;
+}
+
+// ----------------------------------------------------------------------------
+
+const std::vector<SegmentRef> &ModelIndex::segments(std::string_view material) const
+{
+	return segments(_names->find(material));
+}
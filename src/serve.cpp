@@ -0,0 +1,507 @@
+#include "grobj/serve.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "grobj/dump.h"
+#include "grobj/io.h"
+#include "grobj/json.h"
+#include "grobj/model_cache.h"
+#include "grobj/model_index.h"
+#include "grobj/thread_pool.h"
+
+using namespace std::chrono;
+using namespace std::literals;
+
+
+// ----------------------------------------------------------------------------
+// request handling
+
+using Respond = std::function<void(const std::string &)>;
+
+struct Server
+{
+	ModelCache        cache;
+	ThreadPool        pool;
+	std::atomic<bool> stopping { false };
+	std::function<void()> onShutdown;
+
+	Server(const ServeOptions &opts) : cache(opts.cacheBytes), pool(opts.numThreads) {}
+};
+
+// ----------------------------------------------------------------------------
+
+static void model_info(const ModelFile &model, std::ostream &out)
+{
+	size_t meshes = 0;
+	size_t vertices = 0;
+	size_t triangles = 0;
+	for(const auto &node: model.nodes)
+	{
+		if(not node.meshEntity)
+			continue;
+		const auto &md = node.meshEntity.value().meshData;
+		++meshes;
+		vertices += size_t(md.numVertices);
+		for(const auto &seg: md.segments)
+			triangles += size_t(seg.count);
+	}
+
+	out << ",\"nodes\":" << model.nodes.size() << ",\"meshes\":" << meshes << ",\"vertices\":" << vertices << ",\"triangles\":" << triangles;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool model_bounds(const ModelFile &model, std::ostream &out)
+{
+	// union of the stored per-mesh boxes, in each mesh's model space
+	constexpr auto inf = std::numeric_limits<float32>::infinity();
+	Vec3 bmin { inf, inf, inf };
+	Vec3 bmax { -inf, -inf, -inf };
+	auto any = false;
+
+	for(const auto &node: model.nodes)
+	{
+		if(not node.meshEntity)
+			continue;
+		const auto &md = node.meshEntity.value().meshData;
+		bmin = { std::min(bmin.x, md.boundMin.x), std::min(bmin.y, md.boundMin.y), std::min(bmin.z, md.boundMin.z) };
+		bmax = { std::max(bmax.x, md.boundMax.x), std::max(bmax.y, md.boundMax.y), std::max(bmax.z, md.boundMax.z) };
+		any = true;
+	}
+	if(not any)
+		return false;
+
+	out << ",\"min\":";
+	json_vec3(out, bmin);
+	out << ",\"max\":";
+	json_vec3(out, bmax);
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Node by name (with its parent and children) and/or the segments using a material
+static void model_find(const ModelFile &model, const std::string &nodeName, const std::string &material, std::ostream &out)
+{
+	const ModelIndex modelIndex(model);
+
+	if(not nodeName.empty())
+	{
+		const auto node = modelIndex.find_node(nodeName);
+		if(node < 0)
+			out << ",\"node\":null";
+		else
+		{
+			out << ",\"node\":" << node << ",\"parent\":" << model.nodes[size_t(node)].parent << ",\"children\":[";
+			auto first = true;
+			for(const auto child: modelIndex.children(node))
+			{
+				out << (first? "": ",") << child;
+				first = false;
+			}
+			out << ']';
+		}
+	}
+
+	if(not material.empty())
+	{
+		out << ",\"segments\":[";
+		auto first = true;
+		for(const auto &ref: modelIndex.segments(material))
+		{
+			const auto &seg = model.nodes[size_t(ref.node)].meshEntity.value().meshData.segments[size_t(ref.segment)];
+			out << (first? "": ",") << "{\"node\":" << ref.node << ",\"segment\":" << ref.segment << ",\"triangles\":" << seg.count << '}';
+			first = false;
+		}
+		out << ']';
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+static void handle_request(Server &server, const JsonObject &req, std::ostream &out)
+{
+	const auto cmd = json_string(req, "cmd");
+
+	if(cmd == "stats")
+	{
+		const auto stats = server.cache.stats();
+		out << ",\"ok\":true,\"entries\":" << stats.entries << ",\"bytes\":" << stats.bytes
+			<< ",\"hits\":" << stats.hits << ",\"misses\":" << stats.misses << ",\"evictions\":" << stats.evictions;
+		return;
+	}
+	if(cmd == "shutdown")
+	{
+		server.stopping = true;
+		if(server.onShutdown)
+			server.onShutdown();
+		out << ",\"ok\":true";
+		return;
+	}
+	if(cmd != "info" and cmd != "dump" and cmd != "bounds" and cmd != "find" and cmd != "convert")
+	{
+		out << ",\"ok\":false,\"error\":";
+		json_escape(out, "unknown command: '" + cmd + "'");
+		return;
+	}
+
+	const auto filename = json_string(req, "file");
+	if(filename.empty())
+	{
+		out << ",\"ok\":false,\"error\":\"missing 'file'\"";
+		return;
+	}
+
+	bool hit = false;
+	auto model_ = server.cache.get(filename, hit);
+	if(std::holds_alternative<std::string>(model_))
+	{
+		out << ",\"ok\":false,\"error\":";
+		json_escape(out, std::get<std::string>(model_));
+		return;
+	}
+	const auto &model = *std::get<ModelCache::Model>(model_);
+
+	std::ostringstream result;
+	if(cmd == "info")
+		model_info(model, result);
+	else if(cmd == "dump")
+	{
+		Filter filter { 0 };
+		if(json_bool(req, "empty"))
+			filter |= includeEmptyNodes;
+		if(json_bool(req, "bones"))
+			filter |= includeBones;
+		if(json_bool(req, "transforms"))
+			filter |= includeTransforms;
+
+		std::ostringstream text;
+		dump(model, text, filter);
+		result << ",\"dump\":";
+		json_escape(result, text.str());
+	}
+	else if(cmd == "bounds")
+	{
+		if(not model_bounds(model, result))
+			result << ",\"min\":null,\"max\":null";
+	}
+	else if(cmd == "find")
+	{
+		const auto nodeName = json_string(req, "node");
+		const auto material = json_string(req, "material");
+		if(nodeName.empty() and material.empty())
+		{
+			out << ",\"ok\":false,\"error\":\"missing 'node' or 'material'\"";
+			return;
+		}
+		model_find(model, nodeName, material, result);
+	}
+	else if(cmd == "convert")
+	{
+		const auto output = json_string(req, "output");
+		if(output.empty())
+		{
+			out << ",\"ok\":false,\"error\":\"missing 'output'\"";
+			return;
+		}
+		if(auto error = write_obj(output, model); not error.empty())
+		{
+			out << ",\"ok\":false,\"error\":";
+			json_escape(out, error);
+			return;
+		}
+		result << ",\"output\":";
+		json_escape(result, output);
+	}
+
+	out << ",\"ok\":true,\"cached\":" << (hit? "true": "false") << result.str();
+}
+
+// ----------------------------------------------------------------------------
+
+static void dispatch(Server &server, std::string line, Respond respond)
+{
+	const auto T0 = steady_clock::now();
+
+	server.pool.submit([&server, line=std::move(line), respond=std::move(respond), T0] {
+		std::ostringstream out;
+		out << '{';
+
+		auto req_ = json_object_parse(line);
+		if(std::holds_alternative<std::string>(req_))
+		{
+			out << "\"id\":null,\"ok\":false,\"error\":";
+			json_escape(out, "bad request: " + std::get<std::string>(req_));
+		}
+		else
+		{
+			const auto &req = std::get<JsonObject>(req_);
+
+			// echo the id back verbatim, so the client can match responses
+			out << "\"id\":";
+			if(auto id = req.find("id"); id == req.end())
+				out << "null";
+			else if(id->second.isString)
+				json_escape(out, id->second.text);
+			else
+				out << id->second.text;
+
+			try
+			{
+				handle_request(server, req, out);
+			}
+			catch(const std::exception &e)
+			{
+				out << ",\"ok\":false,\"error\":";
+				json_escape(out, e.what());
+			}
+		}
+
+		const auto T1 = steady_clock::now();
+		out << ",\"latency_us\":" << duration<double, std::micro>(T1 - T0).count() << "}\n";
+
+		respond(out.str());
+	});
+}
+
+// ----------------------------------------------------------------------------
+
+// Dispatch every complete line in 'pending', leaving any partial last one
+static void dispatch_lines(Server &server, std::string &pending, const Respond &respond)
+{
+	size_t start = 0;
+	for(auto nl = pending.find('\n'); nl != std::string::npos; nl = pending.find('\n', start))
+	{
+		if(nl > start)
+			dispatch(server, pending.substr(start, nl - start), respond);
+		start = nl + 1;
+	}
+	pending.erase(0, start);
+}
+
+// ----------------------------------------------------------------------------
+
+static int serve_stdio(Server &server)
+{
+	auto outMutex = std::make_shared<std::mutex>();
+	Respond respond = [outMutex](const std::string &response) {
+		std::unique_lock lock(*outMutex);
+		std::fwrite(response.data(), 1, response.size(), stdout);
+		std::fflush(stdout);
+	};
+
+	// 'shutdown' is handled on a pool thread while this one waits for input; a pipe wakes it up
+	int wake[2];
+	if(::pipe(wake) != 0)
+	{
+		std::cerr << "pipe: " << std::strerror(errno) << '\n';
+		return 1;
+	}
+	server.onShutdown = [wakeFd=wake[1]] {
+		const char c = 0;
+		[[maybe_unused]] const auto n = ::write(wakeFd, &c, 1);
+	};
+
+	std::string pending;
+	char buf[16384];
+	while(not server.stopping)
+	{
+		pollfd fds[] { { STDIN_FILENO, POLLIN, 0 }, { wake[0], POLLIN, 0 } };
+		if(::poll(fds, 2, -1) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+		if(fds[1].revents != 0)
+			break;
+
+		const auto n = ::read(STDIN_FILENO, buf, sizeof(buf));
+		if(n < 0 and errno == EINTR)
+			continue;
+		if(n <= 0)
+		{
+			// an unterminated last line still counts
+			if(not pending.empty())
+				dispatch(server, std::move(pending), respond);
+			break;
+		}
+
+		pending.append(buf, size_t(n));
+		dispatch_lines(server, pending, respond);
+	}
+
+	server.pool.wait();
+
+	server.onShutdown = nullptr;
+	::close(wake[0]);
+	::close(wake[1]);
+
+	return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+struct Connection
+{
+	int        fd;
+	std::mutex mutex;
+
+	explicit Connection(int fd_) : fd(fd_) {}
+	~Connection() { ::close(fd); }
+
+	void write(const std::string &data)
+	{
+		std::unique_lock lock(mutex);
+		size_t written = 0;
+		while(written < data.size())
+		{
+			// no SIGPIPE if the client already hung up; that's handled below
+			const auto n = ::send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+			if(n < 0 and errno == EINTR)
+				continue;
+			if(n <= 0)
+				return;  // client went away
+			written += size_t(n);
+		}
+	}
+};
+
+// ----------------------------------------------------------------------------
+
+static void connection_read(Server &server, std::shared_ptr<Connection> conn)
+{
+	Respond respond = [conn](const std::string &response) { conn->write(response); };
+
+	std::string pending;
+	char buf[16384];
+	while(not server.stopping)
+	{
+		const auto n = ::read(conn->fd, buf, sizeof(buf));
+		if(n < 0 and errno == EINTR)
+			continue;
+		if(n <= 0)
+			break;
+
+		pending.append(buf, size_t(n));
+		dispatch_lines(server, pending, respond);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+static int serve_socket(Server &server, const std::string &socketPath)
+{
+	sockaddr_un addr {};
+	addr.sun_family = AF_UNIX;
+	if(socketPath.size() >= sizeof(addr.sun_path))
+	{
+		std::cerr << "socket path too long: " << socketPath << '\n';
+		return 1;
+	}
+	std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+	const auto listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listenFd < 0)
+	{
+		std::cerr << "socket: " << std::strerror(errno) << '\n';
+		return 1;
+	}
+
+	::unlink(socketPath.c_str());
+	if(::bind(listenFd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0 or ::listen(listenFd, 16) != 0)
+	{
+		std::cerr << "bind " << socketPath << ": " << std::strerror(errno) << '\n';
+		::close(listenFd);
+		return 1;
+	}
+	std::cerr << "listening on " << socketPath << '\n';
+
+	// open connections only; each reader thread is detached and removes its own when done
+	std::mutex connMutex;
+	std::condition_variable readersDone;
+	std::unordered_set<Connection *> connections;
+	size_t numReaders = 0;
+
+	// wake up accept() and all connection readers
+	server.onShutdown = [&] {
+		::shutdown(listenFd, SHUT_RDWR);
+		std::unique_lock lock(connMutex);
+		for(auto *conn: connections)
+			::shutdown(conn->fd, SHUT_RD);
+	};
+
+	while(not server.stopping)
+	{
+		const auto fd = ::accept(listenFd, nullptr, nullptr);
+		if(fd < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+
+		auto conn = std::make_shared<Connection>(fd);
+		{
+			std::unique_lock lock(connMutex);
+			connections.insert(conn.get());
+			++numReaders;
+			if(server.stopping)  // missed by onShutdown
+				::shutdown(fd, SHUT_RD);
+		}
+		std::thread([&, conn] {
+			connection_read(server, conn);
+
+			std::unique_lock lock(connMutex);
+			connections.erase(conn.get());
+			if(--numReaders == 0)
+				readersDone.notify_all();
+		}).detach();
+	}
+
+	{
+		std::unique_lock lock(connMutex);
+		readersDone.wait(lock, [&] { return numReaders == 0; });
+	}
+	server.pool.wait();
+
+	server.onShutdown = nullptr;
+	::close(listenFd);
+	::unlink(socketPath.c_str());
+
+	return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+int serve(const ServeOptions &opts)
+{
+	Server server(opts);
+
+	if(opts.socketPath.empty())
+		return serve_stdio(server);
+
+	return serve_socket(server, opts.socketPath);
+}
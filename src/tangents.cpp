@@ -0,0 +1,702 @@
+#include "grobj/tangents.h"
+
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "grobj/math.h"
+#include "grobj/thread_pool.h"
+
+
+static constexpr float32 pi { 3.14159265358979f };
+// triangles per parallel block; smaller meshes aren't worth the overhead
+static constexpr size_t minBlockTriangles { 4096 };
+// triangles gathered at a time into the SoA scratch arrays (sized to stay in L1)
+static constexpr size_t batchTriangles { 64 };
+
+// guards the divisions in the batch loops; those are unconditional, and the result selected
+static constexpr float32 tiny { 1e-30f };
+
+// structure-of-arrays; keeps the per-component loops vectorizable
+struct Soa3
+{
+	std::vector<float32> x, y, z;
+
+	inline void resize(size_t size) { x.assign(size, 0); y.assign(size, 0); z.assign(size, 0); }
+	inline Vec3 get(size_t idx) const { return { x[idx], y[idx], z[idx] }; }
+	inline void add(size_t idx, float32 vx, float32 vy, float32 vz) { x[idx] += vx; y[idx] += vy; z[idx] += vz; }
+};
+
+// ----------------------------------------------------------------------------
+
+static VertexArray make_array(ArrayPurpose purpose, const std::vector<Vec3> &values)
+{
+	VertexArray va;
+	va.purpose = purpose;
+	va.dataType = Float32;
+	va.dim = 3;
+	va.stride = int32(sizeof(Vec3));
+	va.rawVertexData.resize(values.size()*sizeof(Vec3));
+	std::memcpy(va.rawVertexData.data(), values.data(), va.rawVertexData.size());
+
+	return va;
+}
+
+// ----------------------------------------------------------------------------
+
+static float32 corner_angle(const Vec3 &a, const Vec3 &b)
+{
+	const auto lengths = length(a)*length(b);
+	if(lengths <= 0)
+		return 0;
+	return std::acos(std::clamp(dot(a, b) / lengths, -1.f, 1.f));
+}
+
+// ----------------------------------------------------------------------------
+
+// acos() of x clamped to [-1, 1]; branch-free and without errno, so loops using it vectorize.
+//   Abramowitz & Stegun 4.4.46, |error| <= 2e-8 (plus float rounding).
+static inline float32 fast_acos(float32 x)
+{
+	x = std::min(std::max(x, -1.f), 1.f);
+	const auto a = std::fabs(x);
+	auto p = -0.0012624911f;
+	p = p*a + 0.0066700901f;
+	p = p*a - 0.0170881256f;
+	p = p*a + 0.0308918810f;
+	p = p*a - 0.0501743046f;
+	p = p*a + 0.0889789874f;
+	p = p*a - 0.2145988016f;
+	p = p*a + 1.5707963050f;
+	const auto r = std::sqrt(1 - a)*p;
+	return x < 0? pi - r: r;
+}
+
+// ----------------------------------------------------------------------------
+
+// 'v' projected onto the plane perpendicular to (unit) 'n'
+static Vec3 project(const Vec3 &v, const Vec3 &n)
+{
+	return v - n*dot(n, v);
+}
+
+// ----------------------------------------------------------------------------
+
+// Which arrays to generate; none if the mesh lacks what they'd be derived from.
+static TangentSpaceResult wanted(const MeshData &md)
+{
+	TangentSpaceResult want { false, false, false, 0 };
+	if(not usable(md.positionArray, 3) or md.indices.size() < 3)
+		return want;
+
+	const auto hasUV = usable(md.texCoordArray[0], 2);
+	want.normals = not usable(md.normalArray, 3);  // also replaces one we can't read
+	want.tangents = not md.tangentArray and hasUV;
+	want.bitangents = not md.bitangentArray and hasUV;
+
+	return want;
+}
+
+// ----------------------------------------------------------------------------
+
+// Whether the bitangents are to be derived from the mesh's own tangents, rather than generated ones
+static bool keeps_tangents(const MeshData &md, const TangentSpaceResult &want)
+{
+	return want.bitangents and not want.tangents and usable(md.tangentArray, 3);
+}
+
+// ----------------------------------------------------------------------------
+
+static bool valid_triangle(const MeshData &md, size_t tri)
+{
+	for(auto corner = 0u; corner < 3; ++corner)
+	{
+		const auto index = md.indices[tri*3 + corner];
+		if(index < 0 or index >= md.numVertices)
+			return false;
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Orientation of a triangle's uv mapping: 1 preserving, -1 mirrored, 0 degenerate.
+static float32 uv_orientation(const MeshData &md, size_t tri)
+{
+	const auto &uv = md.texCoordArray[0];
+	const auto v0 = size_t(md.indices[tri*3]);
+	const auto v1 = size_t(md.indices[tri*3 + 1]);
+	const auto v2 = size_t(md.indices[tri*3 + 2]);
+
+	const auto du1 = read_component(uv, v1, 0) - read_component(uv, v0, 0);
+	const auto dv1 = read_component(uv, v1, 1) - read_component(uv, v0, 1);
+	const auto du2 = read_component(uv, v2, 0) - read_component(uv, v0, 0);
+	const auto dv2 = read_component(uv, v2, 1) - read_component(uv, v0, 1);
+	const auto det = du1*dv2 - du2*dv1;
+
+	return det > 0? 1.f: det < 0? -1.f: 0.f;
+}
+
+// ----------------------------------------------------------------------------
+
+// Faces of opposite uv orientation don't share a tangent frame (as in MikkTSpace), so a vertex
+//   used by both, i.e. on a mirrored-uv seam, is duplicated and the mirrored faces moved to the copy.
+//   Fills in each vertex's handedness; returns the number of vertices added.
+static size_t split_mirrored(MeshData &md, std::vector<float32> &handedness)
+{
+	const auto numVertices = size_t(md.numVertices);
+	const auto numTriangles = md.indices.size() / 3;
+
+	std::vector<float32> orientation(numTriangles, 0);
+	std::vector<std::uint8_t> used(numVertices, 0);  // bit 0: by preserving faces, bit 1: by mirrored ones
+	for(auto tri = 0u; tri < numTriangles; ++tri)
+	{
+		if(not valid_triangle(md, tri))
+			continue;
+		orientation[tri] = uv_orientation(md, tri);
+		const auto bit = orientation[tri] > 0? 1: orientation[tri] < 0? 2: 0;
+		for(auto corner = 0u; corner < 3; ++corner)
+			used[size_t(md.indices[tri*3 + corner])] |= std::uint8_t(bit);
+	}
+
+	std::vector<int32> copies;  // original vertex of each added one
+	std::vector<int32> copyOf(numVertices, -1);
+	for(auto idx = 0u; idx < numVertices; ++idx)
+	{
+		if(used[idx] == 3)
+		{
+			copyOf[idx] = int32(numVertices + copies.size());
+			copies.push_back(int32(idx));
+		}
+	}
+
+	handedness.assign(numVertices + copies.size(), 1.f);
+	for(auto idx = 0u; idx < numVertices; ++idx)
+	{
+		if(used[idx] == 2)
+			handedness[idx] = -1;
+	}
+	std::fill(handedness.begin() + long(numVertices), handedness.end(), -1.f);
+
+	if(copies.empty())
+		return 0;
+
+	for(auto tri = 0u; tri < numTriangles; ++tri)
+	{
+		if(orientation[tri] >= 0)
+			continue;
+		for(auto corner = 0u; corner < 3; ++corner)
+		{
+			auto &index = md.indices[tri*3 + corner];
+			if(copyOf[size_t(index)] >= 0)
+				index = copyOf[size_t(index)];
+		}
+	}
+
+	auto duplicate = [&](VertexArray &va) {
+		const auto stride = size_t(va.stride);
+		if(not va or va.rawVertexData.size() < numVertices*stride)
+			return;
+		va.rawVertexData.resize((numVertices + copies.size())*stride);
+		for(auto idx = 0u; idx < copies.size(); ++idx)
+			std::memcpy(va.rawVertexData.data() + (numVertices + idx)*stride, va.rawVertexData.data() + size_t(copies[idx])*stride, stride);
+	};
+	for(auto *va: { &md.positionArray, &md.normalArray, &md.tangentArray, &md.bitangentArray, &md.colorArray, &md.boneArray, &md.boneWeightArray })
+		duplicate(*va);
+	for(auto &va: md.texCoordArray)
+		duplicate(va);
+
+	md.numVertices += int32(copies.size());
+
+	return copies.size();
+}
+
+// ----------------------------------------------------------------------------
+
+// Normalize the accumulated tangent (orthogonal to the normal up to rounding), and derive the bitangent.
+static void finish_vertex(const Vec3 &normal, const Vec3 &tangentAcc, float32 handedness, Vec3 &tangentOut, Vec3 &bitangentOut)
+{
+	tangentOut = normalize(project(tangentAcc, normal));
+	bitangentOut = cross(normal, tangentOut)*handedness;
+}
+
+// ----------------------------------------------------------------------------
+
+static std::vector<Vec3> read_normals(const MeshData &md)
+{
+	std::vector<Vec3> normals(size_t(md.numVertices));
+	for(auto idx = 0u; idx < normals.size(); ++idx)
+		normals[idx] = normalize(read_vec3(md.normalArray, idx));
+	return normals;
+}
+
+// ----------------------------------------------------------------------------
+
+TangentSpaceResult generate_tangent_space_reference(MeshData &md, NormalWeighting weighting)
+{
+	auto want = wanted(md);
+	if(not want.normals and not want.tangents and not want.bitangents)
+		return want;
+
+	const auto numTriangles = md.indices.size() / 3;
+
+	if(want.normals)
+	{
+		std::vector<Vec3> normals(size_t(md.numVertices), Vec3{ 0, 0, 0 });
+		for(auto tri = 0u; tri < numTriangles; ++tri)
+		{
+			if(not valid_triangle(md, tri))
+				continue;
+
+			size_t v[3];
+			Vec3 p[3];
+			for(auto corner = 0u; corner < 3; ++corner)
+			{
+				v[corner] = size_t(md.indices[tri*3 + corner]);
+				p[corner] = read_vec3(md.positionArray, v[corner]);
+			}
+
+			const auto faceNormal = cross(p[1] - p[0], p[2] - p[0]);  // length = 2 * area
+			for(auto corner = 0u; corner < 3; ++corner)
+			{
+				const auto &p0 = p[corner];
+				const auto angle = corner_angle(p[(corner + 1) % 3] - p0, p[(corner + 2) % 3] - p0);
+				const auto n = weighting == NormalWeighting::Area? faceNormal: normalize(faceNormal)*angle;
+				normals[v[corner]] = normals[v[corner]] + n;
+			}
+		}
+
+		for(auto &n: normals)
+			n = normalize(n);
+		md.normalArray = make_array(Normal, normals);
+	}
+
+	if(not want.tangents and not want.bitangents)
+		return want;
+
+	std::vector<float32> handedness;
+	want.splitVertices = split_mirrored(md, handedness);
+
+	const auto numVertices = size_t(md.numVertices);
+	const auto normals = read_normals(md);
+	const auto &uv = md.texCoordArray[0];
+
+	std::vector<Vec3> tangents(numVertices, Vec3{ 0, 0, 0 });
+	std::vector<Vec3> bitangents(numVertices);
+
+	if(keeps_tangents(md, want))
+	{
+		for(auto idx = 0u; idx < numVertices; ++idx)
+			tangents[idx] = read_vec3(md.tangentArray, idx);
+	}
+	else
+	{
+		for(auto tri = 0u; tri < numTriangles; ++tri)
+		{
+			if(not valid_triangle(md, tri))
+				continue;
+
+			size_t v[3];
+			Vec3 p[3];
+			for(auto corner = 0u; corner < 3; ++corner)
+			{
+				v[corner] = size_t(md.indices[tri*3 + corner]);
+				p[corner] = read_vec3(md.positionArray, v[corner]);
+			}
+
+			const auto sign = uv_orientation(md, tri);
+			if(sign == 0)
+				continue;
+
+			const auto e1 = p[1] - p[0];
+			const auto e2 = p[2] - p[0];
+			const auto dv1 = read_component(uv, v[1], 1) - read_component(uv, v[0], 1);
+			const auto dv2 = read_component(uv, v[2], 1) - read_component(uv, v[0], 1);
+			const auto faceTangent = (e1*dv2 - e2*dv1)*sign;
+
+			// projected onto each vertex's tangent plane, weighted by the corner angle within that plane
+			for(auto corner = 0u; corner < 3; ++corner)
+			{
+				const auto &n = normals[v[corner]];
+				const auto &p0 = p[corner];
+				const auto angle = corner_angle(project(p[(corner + 1) % 3] - p0, n), project(p[(corner + 2) % 3] - p0, n));
+				tangents[v[corner]] = tangents[v[corner]] + normalize(project(faceTangent, n))*angle;
+			}
+		}
+	}
+
+	for(auto idx = 0u; idx < numVertices; ++idx)
+		finish_vertex(normals[idx], tangents[idx], handedness[idx], tangents[idx], bitangents[idx]);
+
+	if(want.tangents)
+		md.tangentArray = make_array(Tangent, tangents);
+	if(want.bitangents)
+		md.bitangentArray = make_array(Bitangent, bitangents);
+
+	return want;
+}
+
+// ----------------------------------------------------------------------------
+
+// SoA scratch of the corner positions of up to 'batchTriangles' triangles
+struct TriangleBatch
+{
+	float32 p0x[batchTriangles], p0y[batchTriangles], p0z[batchTriangles];
+	float32 p1x[batchTriangles], p1y[batchTriangles], p1z[batchTriangles];
+	float32 p2x[batchTriangles], p2y[batchTriangles], p2z[batchTriangles];
+	size_t  tris[batchTriangles];
+};
+
+// Gather the valid triangles of [begin, end) into 'b', a batch at a time, and call fn(count) for each batch.
+template<typename Fn>
+static void for_each_batch(const MeshData &md, size_t begin, size_t end, TriangleBatch &b, Fn fn)
+{
+	for(auto batchBegin = begin; batchBegin < end; batchBegin += batchTriangles)
+	{
+		size_t count = 0;
+		for(auto tri = batchBegin; tri < std::min(end, batchBegin + batchTriangles); ++tri)
+		{
+			if(not valid_triangle(md, tri))
+				continue;
+
+			const auto p0 = read_vec3(md.positionArray, size_t(md.indices[tri*3]));
+			const auto p1 = read_vec3(md.positionArray, size_t(md.indices[tri*3 + 1]));
+			const auto p2 = read_vec3(md.positionArray, size_t(md.indices[tri*3 + 2]));
+			b.p0x[count] = p0.x;  b.p0y[count] = p0.y;  b.p0z[count] = p0.z;
+			b.p1x[count] = p1.x;  b.p1y[count] = p1.y;  b.p1z[count] = p1.z;
+			b.p2x[count] = p2.x;  b.p2y[count] = p2.y;  b.p2z[count] = p2.z;
+			b.tris[count] = tri;
+			++count;
+		}
+		fn(count);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Accumulate the face normals of triangles [begin, end) into 'acc'.
+static void accumulate_normals(const MeshData &md, NormalWeighting weighting, size_t begin, size_t end, Soa3 &acc)
+{
+	TriangleBatch b;
+	float32 nx[batchTriangles], ny[batchTriangles], nz[batchTriangles];
+	float32 weight[3][batchTriangles];
+
+	for_each_batch(md, begin, end, b, [&](size_t count) {
+		for(auto idx = 0u; idx < count; ++idx)
+		{
+			const auto e1x = b.p1x[idx] - b.p0x[idx], e1y = b.p1y[idx] - b.p0y[idx], e1z = b.p1z[idx] - b.p0z[idx];
+			const auto e2x = b.p2x[idx] - b.p0x[idx], e2y = b.p2y[idx] - b.p0y[idx], e2z = b.p2z[idx] - b.p0z[idx];
+			nx[idx] = e1y*e2z - e1z*e2y;
+			ny[idx] = e1z*e2x - e1x*e2z;
+			nz[idx] = e1x*e2y - e1y*e2x;
+		}
+
+		if(weighting == NormalWeighting::Area)
+		{
+			for(auto corner = 0u; corner < 3; ++corner)
+				std::fill(weight[corner], weight[corner] + count, 1.f);
+		}
+		else
+		{
+			for(auto idx = 0u; idx < count; ++idx)
+			{
+				const auto e1x = b.p1x[idx] - b.p0x[idx], e1y = b.p1y[idx] - b.p0y[idx], e1z = b.p1z[idx] - b.p0z[idx];
+				const auto e2x = b.p2x[idx] - b.p0x[idx], e2y = b.p2y[idx] - b.p0y[idx], e2z = b.p2z[idx] - b.p0z[idx];
+				const auto e3x = b.p2x[idx] - b.p1x[idx], e3y = b.p2y[idx] - b.p1y[idx], e3z = b.p2z[idx] - b.p1z[idx];
+				const auto l1 = std::sqrt(e1x*e1x + e1y*e1y + e1z*e1z);
+				const auto l2 = std::sqrt(e2x*e2x + e2y*e2y + e2z*e2z);
+				const auto l3 = std::sqrt(e3x*e3x + e3y*e3y + e3z*e3z);
+				const auto d0 = e1x*e2x + e1y*e2y + e1z*e2z;
+				const auto d1 = -(e1x*e3x + e1y*e3y + e1z*e3z);  // (p2-p1).(p0-p1)
+				const auto c0 = d0/std::max(l1*l2, tiny);
+				const auto c1 = d1/std::max(l1*l3, tiny);
+				const auto a0 = fast_acos(l1*l2 > 0? c0: 1.f);
+				const auto a1 = fast_acos(l1*l3 > 0? c1: 1.f);
+
+				// the weights also normalize the face normal
+				const auto nl = std::sqrt(nx[idx]*nx[idx] + ny[idx]*ny[idx] + nz[idx]*nz[idx]);
+				const auto inverse = 1/std::max(nl, tiny);
+				const auto scale = nl > 0? inverse: 0.f;
+				weight[0][idx] = a0*scale;
+				weight[1][idx] = a1*scale;
+				weight[2][idx] = std::max(0.f, pi - a0 - a1)*scale;
+			}
+		}
+
+		// scatter to the vertices; stays scalar, as vertices repeat within a batch
+		for(auto idx = 0u; idx < count; ++idx)
+		{
+			for(auto corner = 0u; corner < 3; ++corner)
+			{
+				const auto vertex = size_t(md.indices[b.tris[idx]*3 + corner]);
+				const auto w = weight[corner][idx];
+				acc.add(vertex, nx[idx]*w, ny[idx]*w, nz[idx]*w);
+			}
+		}
+	});
+}
+
+// ----------------------------------------------------------------------------
+
+// Accumulate the (projected, angle weighted) face tangents of triangles [begin, end) into 'acc'.
+static void accumulate_tangents(const MeshData &md, const std::vector<Vec3> &normals, size_t begin, size_t end, Soa3 &acc)
+{
+	TriangleBatch b;
+	float32 dv1[batchTriangles], dv2[batchTriangles], sign[batchTriangles];
+	float32 n[3][3][batchTriangles];  // [corner][component]
+	float32 t[3][3][batchTriangles];  // weighted tangent per [corner][component]
+
+	const auto &uv = md.texCoordArray[0];
+
+	for_each_batch(md, begin, end, b, [&](size_t count) {
+		for(auto idx = 0u; idx < count; ++idx)
+		{
+			const auto tri = b.tris[idx];
+			size_t v[3];
+			for(auto corner = 0u; corner < 3; ++corner)
+			{
+				v[corner] = size_t(md.indices[tri*3 + corner]);
+				const auto &normal = normals[v[corner]];
+				n[corner][0][idx] = normal.x;
+				n[corner][1][idx] = normal.y;
+				n[corner][2][idx] = normal.z;
+			}
+			const auto u0 = read_component(uv, v[0], 0);
+			const auto w0 = read_component(uv, v[0], 1);
+			const auto du1 = read_component(uv, v[1], 0) - u0;
+			const auto du2 = read_component(uv, v[2], 0) - u0;
+			dv1[idx] = read_component(uv, v[1], 1) - w0;
+			dv2[idx] = read_component(uv, v[2], 1) - w0;
+			const auto det = du1*dv2[idx] - du2*dv1[idx];
+			sign[idx] = det > 0? 1.f: det < 0? -1.f: 0.f;  // degenerate uv: no contribution
+		}
+
+		for(auto corner = 0u; corner < 3; ++corner)
+		{
+			const float32 *px[3] { b.p0x, b.p1x, b.p2x };
+			const float32 *py[3] { b.p0y, b.p1y, b.p2y };
+			const float32 *pz[3] { b.p0z, b.p1z, b.p2z };
+			const auto c0 = corner, c1 = (corner + 1) % 3, c2 = (corner + 2) % 3;
+
+			for(auto idx = 0u; idx < count; ++idx)
+			{
+				const auto nx = n[corner][0][idx], ny = n[corner][1][idx], nz = n[corner][2][idx];
+
+				// face tangent, projected onto the vertex's tangent plane
+				const auto e1x = b.p1x[idx] - b.p0x[idx], e1y = b.p1y[idx] - b.p0y[idx], e1z = b.p1z[idx] - b.p0z[idx];
+				const auto e2x = b.p2x[idx] - b.p0x[idx], e2y = b.p2y[idx] - b.p0y[idx], e2z = b.p2z[idx] - b.p0z[idx];
+				auto tx = (e1x*dv2[idx] - e2x*dv1[idx])*sign[idx];
+				auto ty = (e1y*dv2[idx] - e2y*dv1[idx])*sign[idx];
+				auto tz = (e1z*dv2[idx] - e2z*dv1[idx])*sign[idx];
+				const auto tn = nx*tx + ny*ty + nz*tz;
+				tx -= nx*tn;  ty -= ny*tn;  tz -= nz*tn;
+
+				// the corner's edges, projected likewise
+				auto ax = px[c1][idx] - px[c0][idx], ay = py[c1][idx] - py[c0][idx], az = pz[c1][idx] - pz[c0][idx];
+				auto bx = px[c2][idx] - px[c0][idx], by = py[c2][idx] - py[c0][idx], bz = pz[c2][idx] - pz[c0][idx];
+				const auto an = nx*ax + ny*ay + nz*az;
+				const auto bn = nx*bx + ny*by + nz*bz;
+				ax -= nx*an;  ay -= ny*an;  az -= nz*an;
+				bx -= nx*bn;  by -= ny*bn;  bz -= nz*bn;
+
+				const auto la = std::sqrt(ax*ax + ay*ay + az*az);
+				const auto lb = std::sqrt(bx*bx + by*by + bz*bz);
+				const auto lt = std::sqrt(tx*tx + ty*ty + tz*tz);
+				const auto cosine = (ax*bx + ay*by + az*bz)/std::max(la*lb, tiny);
+				const auto angle = fast_acos(la*lb > 0? cosine: 1.f);
+				const auto weight = angle/std::max(lt, tiny);
+				const auto w = lt > 0? weight: 0.f;
+
+				t[corner][0][idx] = tx*w;
+				t[corner][1][idx] = ty*w;
+				t[corner][2][idx] = tz*w;
+			}
+		}
+
+		// scatter to the vertices; stays scalar, as vertices repeat within a batch
+		for(auto idx = 0u; idx < count; ++idx)
+		{
+			for(auto corner = 0u; corner < 3; ++corner)
+			{
+				const auto vertex = size_t(md.indices[b.tris[idx]*3 + corner]);
+				acc.add(vertex, t[corner][0][idx], t[corner][1][idx], t[corner][2][idx]);
+			}
+		}
+	});
+}
+
+// ----------------------------------------------------------------------------
+
+// Accumulate per block, each into its own 'accs' entry (so the scatter needs no synchronization),
+//   then sum them up into accs[0], also in blocks.
+template<typename Fn>
+static void accumulate_blocks(ThreadPool *pool, size_t numTriangles, size_t numVertices, std::vector<Soa3> &accs, Fn accumulate)
+{
+	parallel_blocks(pool, numTriangles, accs.size(), [&](size_t block, size_t begin, size_t end) {
+		accs[block].resize(numVertices);
+		accumulate(begin, end, accs[block]);
+	});
+
+	parallel_blocks(pool, numVertices, accs.size(), [&](size_t, size_t begin, size_t end) {
+		auto add = [begin, end](float32 *sum, const float32 *acc) {
+			for(auto idx = begin; idx < end; ++idx)
+				sum[idx] += acc[idx];
+		};
+		for(auto block = 1u; block < accs.size(); ++block)
+		{
+			const auto &acc = accs[block];
+			if(acc.x.empty())  // block never ran
+				continue;
+			add(accs[0].x.data(), acc.x.data());
+			add(accs[0].y.data(), acc.y.data());
+			add(accs[0].z.data(), acc.z.data());
+		}
+	});
+}
+
+// ----------------------------------------------------------------------------
+
+TangentSpaceResult generate_tangent_space(MeshData &md, NormalWeighting weighting, ThreadPool *pool)
+{
+	auto want = wanted(md);
+	if(not want.normals and not want.tangents and not want.bitangents)
+		return want;
+
+	const auto numTriangles = md.indices.size() / 3;
+	const auto maxBlocks = pool? pool->size(): 1;
+	const auto numBlocks = std::max<size_t>(1, std::min(maxBlocks, numTriangles / minBlockTriangles));
+
+	std::vector<Soa3> accs(numBlocks);
+
+	if(want.normals)
+	{
+		const auto numVertices = size_t(md.numVertices);
+		accumulate_blocks(pool, numTriangles, numVertices, accs, [&](size_t begin, size_t end, Soa3 &acc) {
+			accumulate_normals(md, weighting, begin, end, acc);
+		});
+
+		std::vector<Vec3> normals(numVertices);
+		for(auto idx = 0u; idx < numVertices; ++idx)
+			normals[idx] = normalize(accs[0].get(idx));
+		md.normalArray = make_array(Normal, normals);
+	}
+
+	if(not want.tangents and not want.bitangents)
+		return want;
+
+	// the tangents need the final normals, including those of split vertices
+	std::vector<float32> handedness;
+	want.splitVertices = split_mirrored(md, handedness);
+
+	const auto numVertices = size_t(md.numVertices);
+	const auto normals = read_normals(md);
+
+	std::vector<Vec3> tangents(numVertices);
+	std::vector<Vec3> bitangents(numVertices);
+	if(keeps_tangents(md, want))
+	{
+		parallel_blocks(pool, numVertices, numBlocks, [&](size_t, size_t begin, size_t end) {
+			for(auto idx = begin; idx < end; ++idx)
+				finish_vertex(normals[idx], read_vec3(md.tangentArray, idx), handedness[idx], tangents[idx], bitangents[idx]);
+		});
+	}
+	else
+	{
+		accs.assign(numBlocks, Soa3());
+		accumulate_blocks(pool, numTriangles, numVertices, accs, [&](size_t begin, size_t end, Soa3 &acc) {
+			accumulate_tangents(md, normals, begin, end, acc);
+		});
+
+		parallel_blocks(pool, numVertices, numBlocks, [&](size_t, size_t begin, size_t end) {
+			for(auto idx = begin; idx < end; ++idx)
+				finish_vertex(normals[idx], accs[0].get(idx), handedness[idx], tangents[idx], bitangents[idx]);
+		});
+	}
+
+	if(want.tangents)
+		md.tangentArray = make_array(Tangent, tangents);
+	if(want.bitangents)
+		md.bitangentArray = make_array(Bitangent, bitangents);
+
+	return want;
+}
+
+// ----------------------------------------------------------------------------
+
+TangentSpaceTotals generate_tangent_space(ModelFile &model, NormalWeighting weighting, ThreadPool *pool)
+{
+	TangentSpaceTotals totals { 0, 0 };
+	for(auto &node: model.nodes)
+	{
+		if(not node.meshEntity)
+			continue;
+		const auto result = generate_tangent_space(node.meshEntity.value().meshData, weighting, pool);
+		totals.arrays += size_t(result.normals) + size_t(result.tangents) + size_t(result.bitangents);
+		totals.splitVertices += result.splitVertices;
+	}
+	return totals;
+}
+
+// ----------------------------------------------------------------------------
+
+static float32 max_deviation(const VertexArray &a, const VertexArray &b, size_t numVertices)
+{
+	// in degrees
+	auto worst = 0.f;
+	for(auto idx = 0u; idx < numVertices; ++idx)
+	{
+		const auto va = read_vec3(a, idx);
+		const auto vb = read_vec3(b, idx);
+		if(length(va) == 0 or length(vb) == 0)
+			continue;
+		worst = std::max(worst, corner_angle(va, vb)*180/pi);
+	}
+	return worst;
+}
+
+// ----------------------------------------------------------------------------
+
+void verify_tangent_space(const ModelFile &model, NormalWeighting weighting, ThreadPool *pool, std::ostream &out)
+{
+	using namespace std::chrono;
+
+	duration<double, std::micro> referenceTime { 0 };
+	duration<double, std::micro> fastTime { 0 };
+	float32 worst[3] { 0, 0, 0 };
+
+	for(const auto &node: model.nodes)
+	{
+		if(not node.meshEntity)
+			continue;
+
+		// generate everything, regardless of what the file has
+		auto reference = node.meshEntity.value().meshData;
+		reference.normalArray = VertexArray();
+		reference.tangentArray = VertexArray();
+		reference.bitangentArray = VertexArray();
+		auto fast = reference;
+
+		const auto T0 = steady_clock::now();
+		const auto generated = generate_tangent_space_reference(reference, weighting);
+		const auto T1 = steady_clock::now();
+		generate_tangent_space(fast, weighting, pool);
+		const auto T2 = steady_clock::now();
+
+		referenceTime += T1 - T0;
+		fastTime += T2 - T1;
+
+		const auto numVertices = size_t(reference.numVertices);
+		if(generated.normals)
+			worst[0] = std::max(worst[0], max_deviation(reference.normalArray, fast.normalArray, numVertices));
+		if(generated.tangents)
+			worst[1] = std::max(worst[1], max_deviation(reference.tangentArray, fast.tangentArray, numVertices));
+		if(generated.bitangents)
+			worst[2] = std::max(worst[2], max_deviation(reference.bitangentArray, fast.bitangentArray, numVertices));
+	}
+
+	out << "  tangent space: reference " << referenceTime.count() << " µs, fast " << fastTime.count() << " µs\n";
+	out << "  max deviation: normals " << worst[0] << "°  tangents " << worst[1] << "°  bitangents " << worst[2] << "°\n";
+}
@@ -0,0 +1,77 @@
+#include "grobj/thread_pool.h"
+
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+
+ThreadPool::ThreadPool(size_t numThreads)
+{
+	if(numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	_workers.reserve(numThreads);
+	for(auto idx = 0u; idx < numThreads; ++idx)
+		_workers.emplace_back([this] { worker(); });
+}
+
+// ----------------------------------------------------------------------------
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock lock(_mutex);
+		_stopping = true;
+	}
+	_taskAvailable.notify_all();
+
+	for(auto &thread: _workers)
+		thread.join();
+}
+
+// ----------------------------------------------------------------------------
+
+void ThreadPool::submit(Task task)
+{
+	{
+		std::unique_lock lock(_mutex);
+		_tasks.push_back(std::move(task));
+	}
+	_taskAvailable.notify_one();
+}
+
+// ----------------------------------------------------------------------------
+
+void ThreadPool::wait()
+{
+	std::unique_lock lock(_mutex);
+	_idle.wait(lock, [this] { return _tasks.empty() and _busy == 0; });
+}
+
+// ----------------------------------------------------------------------------
+
+void ThreadPool::worker()
+{
+	while(true)
+	{
+		Task task;
+		{
+			std::unique_lock lock(_mutex);
+			_taskAvailable.wait(lock, [this] { return _stopping or not _tasks.empty(); });
+			if(_tasks.empty()) // i.e. stopping
+				return;
+
+			task = std::move(_tasks.front());
+			_tasks.pop_front();
+			++_busy;
+		}
+
+		task();
+
+		{
+			std::unique_lock lock(_mutex);
+			--_busy;
+			if(_tasks.empty() and _busy == 0)
+				_idle.notify_all();
+		}
+	}
+}
@@ -0,0 +1,493 @@
+#include "grobj/watch.h"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "grobj/hash.h"
+#include "grobj/io.h"
+#include "grobj/thread_pool.h"
+
+using namespace std::chrono;
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+
+static constexpr auto manifestName { ".grobj-manifest" };
+
+struct ManifestEntry
+{
+	std::uintmax_t size;
+	std::int64_t   mtime;   // nanoseconds since the epoch
+	std::uint64_t  hash;    // of the file contents
+	std::string    output;
+	std::string    options; // what the output was converted with, see options_key()
+};
+
+// keyed by the input path, relative to the input directory
+using Manifest = std::unordered_map<std::string, ManifestEntry>;
+
+// The options that change the output; an entry converted with others is reconverted
+static std::string options_key(const WatchOptions &opts)
+{
+	if(not opts.generateTangents)
+		return "plain";
+	return opts.normalWeighting == NormalWeighting::Angle? "tangents-angle": "tangents-area";
+}
+
+// ----------------------------------------------------------------------------
+
+struct Watcher
+{
+	WatchOptions opts;
+	std::string  optionsKey;
+	fs::path     inputRoot;
+	fs::path     outputRoot;
+	Manifest     manifest;
+	std::mutex   manifestMutex;
+	bool         manifestDirty { false };
+	ThreadPool   pool;
+
+	Watcher(const WatchOptions &opts_) : opts(opts_), optionsKey(options_key(opts_)), pool(opts_.numThreads) {}
+};
+
+static volatile std::sig_atomic_t g_interrupted = 0;
+
+// ----------------------------------------------------------------------------
+
+static void on_signal(int)
+{
+	g_interrupted = 1;
+}
+
+// ----------------------------------------------------------------------------
+
+static Manifest manifest_load(const fs::path &filename)
+{
+	// one entry per line:  <size> <mtime> <hash> <input>\t<output>\t<options>
+	//   (no options in older manifests, so those entries are reconverted)
+	Manifest manifest;
+
+	std::ifstream in(filename);
+	std::string line;
+	while(std::getline(in, line))
+	{
+		ManifestEntry entry;
+		char hashHex[17] { 0 };
+		int offset = 0;
+		if(std::sscanf(line.c_str(), "%ju %jd %16s %n", &entry.size, &entry.mtime, hashHex, &offset) != 3)
+			continue;
+		entry.hash = std::strtoull(hashHex, nullptr, 16);
+
+		const auto tab = line.find('\t', size_t(offset));
+		if(tab == std::string::npos)
+			continue;
+		const auto tab2 = line.find('\t', tab + 1);
+		entry.output = line.substr(tab + 1, tab2 == std::string::npos? std::string::npos: tab2 - tab - 1);
+		if(tab2 != std::string::npos)
+			entry.options = line.substr(tab2 + 1);
+		manifest.emplace(line.substr(size_t(offset), tab - size_t(offset)), std::move(entry));
+	}
+
+	return manifest;
+}
+
+// ----------------------------------------------------------------------------
+
+static void manifest_save(Watcher &w)
+{
+	std::unique_lock lock(w.manifestMutex);
+	if(not w.manifestDirty)
+		return;
+
+	const auto filename = w.outputRoot / manifestName;
+	const auto tmpFilename = fs::path(filename).concat(".tmp");
+	{
+		std::ofstream out(tmpFilename, std::ios::trunc);
+		char hashHex[17];
+		for(const auto &[input, entry]: w.manifest)
+		{
+			std::snprintf(hashHex, sizeof(hashHex), "%016jx", std::uintmax_t(entry.hash));
+			out << entry.size << ' ' << entry.mtime << ' ' << hashHex << ' ' << input << '\t' << entry.output << '\t' << entry.options << '\n';
+		}
+		if(not out)
+		{
+			std::cerr << "failed writing " << tmpFilename.generic_string() << '\n';
+			return;
+		}
+	}
+
+	std::error_code ec;
+	fs::rename(tmpFilename, filename, ec);
+	if(ec)
+		std::cerr << "failed writing " << filename.generic_string() << ": " << ec.message() << '\n';
+	else
+		w.manifestDirty = false;
+}
+
+// ----------------------------------------------------------------------------
+
+static std::optional<std::uint64_t> file_hash(const fs::path &filename)
+{
+	auto *fp = std::fopen(filename.c_str(), "rb");
+	if(not fp)
+		return std::nullopt;
+
+	Closer _{ fp };
+
+	Fnv1a hash;
+	byte buf[65536];
+	size_t nread;
+	while((nread = std::fread(buf, 1, sizeof(buf), fp)) > 0)
+		hash.update(buf, nread);
+	if(std::ferror(fp))
+		return std::nullopt;
+
+	return hash.value;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool file_exists(const fs::path &path)
+{
+	struct stat st;
+	return ::stat(path.c_str(), &st) == 0;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool is_model(const fs::path &path)
+{
+	return path.extension() == ".model";
+}
+
+// ----------------------------------------------------------------------------
+
+static void convert(Watcher &w, const std::string &input, ManifestEntry entry)
+{
+	const auto T0 = steady_clock::now();
+
+	std::string error;
+	try
+	{
+		auto model_ = read_model((w.inputRoot / input).string());
+		if(std::holds_alternative<std::string>(model_))
+			error = std::get<std::string>(model_);
+		else
+		{
+			auto &model = std::get<ModelFile>(model_);
+			if(w.opts.generateTangents)
+				generate_tangent_space(model, w.opts.normalWeighting);  // already on a pool thread
+
+			std::error_code ec;
+			fs::create_directories(fs::path(entry.output).parent_path(), ec);
+			error = write_obj(entry.output, model);
+		}
+	}
+	catch(const std::exception &e)
+	{
+		error = "FAILED: "s + e.what();
+	}
+
+	if(not error.empty())
+	{
+		// not recorded in the manifest; it will be retried on the next change (or run)
+		std::cerr << "[" << input << "]: " << error << '\n';
+		return;
+	}
+
+	const auto T1 = steady_clock::now();
+	std::cout << "[" << input << "] wrote Wavefront OBJ: " << entry.output << "  (" << duration_cast<microseconds>(T1 - T0).count() << " µs)\n";
+
+	std::unique_lock lock(w.manifestMutex);
+	w.manifest[input] = std::move(entry);
+	w.manifestDirty = true;
+}
+
+// ----------------------------------------------------------------------------
+
+static void forget(Watcher &w, const std::string &input)
+{
+	std::unique_lock lock(w.manifestMutex);
+
+	auto found = w.manifest.find(input);
+	if(found == w.manifest.end())
+		return;
+
+	std::error_code ec;
+	fs::remove(found->second.output, ec);
+	std::cout << "[" << input << "] removed; deleted " << found->second.output << '\n';
+
+	w.manifest.erase(found);
+	w.manifestDirty = true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Compare an input against the manifest and queue a conversion if it changed.
+//   The common case (same size and mtime) costs one stat() of the input and one of the output.
+static void check(Watcher &w, const fs::path &path)
+{
+	const auto input = path.lexically_relative(w.inputRoot).generic_string();
+
+	struct stat st;
+	if(::stat(path.c_str(), &st) != 0 or not S_ISREG(st.st_mode))
+	{
+		forget(w, input);
+		return;
+	}
+
+	const auto size = std::uintmax_t(st.st_size);
+	const auto mtime = std::int64_t(st.st_mtim.tv_sec)*1'000'000'000 + std::int64_t(st.st_mtim.tv_nsec);
+
+	auto output = (w.outputRoot / input).replace_extension(".obj").string();
+
+	std::optional<ManifestEntry> known;
+	{
+		std::unique_lock lock(w.manifestMutex);
+		if(auto found = w.manifest.find(input); found != w.manifest.end())
+			known = found->second;
+	}
+
+	if(known and known->size == size and known->mtime == mtime and known->output == output and known->options == w.optionsKey and file_exists(output))
+		return;
+
+	w.pool.submit([&w, path, input, size, mtime, output=std::move(output), known]() mutable {
+		const auto hash = file_hash(path);
+		if(not hash)
+			return;
+
+		ManifestEntry entry { size, mtime, hash.value(), std::move(output), w.optionsKey };
+
+		// touched but not modified; only refresh the stat info
+		if(known and known->hash == entry.hash and known->output == entry.output and known->options == entry.options and file_exists(entry.output))
+		{
+			std::unique_lock lock(w.manifestMutex);
+			w.manifest[input] = std::move(entry);
+			w.manifestDirty = true;
+			return;
+		}
+
+		convert(w, input, std::move(entry));
+	});
+}
+
+// ----------------------------------------------------------------------------
+
+static void scan(Watcher &w, const fs::path &dir)
+{
+	std::error_code ec;
+	for(fs::recursive_directory_iterator iter(dir, ec), end; not ec and iter != end; iter.increment(ec))
+	{
+		if(iter->is_regular_file(ec) and is_model(iter->path()))
+			check(w, iter->path());
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+static void remove_missing(Watcher &w)
+{
+	std::vector<std::string> missing;
+	{
+		std::unique_lock lock(w.manifestMutex);
+		for(const auto &[input, entry]: w.manifest)
+		{
+			if(not file_exists(w.inputRoot / input))
+				missing.push_back(input);
+		}
+	}
+
+	for(const auto &input: missing)
+		forget(w, input);
+}
+
+// ----------------------------------------------------------------------------
+
+static void add_watches(int fd, const fs::path &dir, std::unordered_map<int, fs::path> &watches)
+{
+	constexpr auto mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+	auto add = [&](const fs::path &path) {
+		const auto wd = inotify_add_watch(fd, path.c_str(), mask);
+		if(wd < 0)
+			std::cerr << "inotify_add_watch " << path.generic_string() << ": " << std::strerror(errno) << '\n';
+		else
+			watches[wd] = path;
+	};
+
+	add(dir);
+
+	std::error_code ec;
+	for(fs::recursive_directory_iterator iter(dir, ec), end; not ec and iter != end; iter.increment(ec))
+	{
+		if(iter->is_directory(ec))
+			add(iter->path());
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+int watch(const WatchOptions &opts)
+{
+	Watcher w(opts);
+
+	std::error_code ec;
+	w.inputRoot = fs::canonical(opts.inputDir, ec);
+	if(ec or not fs::is_directory(w.inputRoot))
+	{
+		std::cerr << "not a directory: " << opts.inputDir << '\n';
+		return 1;
+	}
+	w.outputRoot = opts.outputDir.empty()? w.inputRoot: fs::absolute(opts.outputDir);
+	fs::create_directories(w.outputRoot, ec);
+
+	w.manifest = manifest_load(w.outputRoot / manifestName);
+
+	const auto fd = inotify_init1(IN_CLOEXEC);
+	if(fd < 0)
+	{
+		std::cerr << "inotify_init: " << std::strerror(errno) << '\n';
+		return 1;
+	}
+
+	// install the watches before the initial scan, so nothing slips between them
+	std::unordered_map<int, fs::path> watches;
+	add_watches(fd, w.inputRoot, watches);
+
+	{
+		const auto T0 = steady_clock::now();
+		remove_missing(w);
+		scan(w, w.inputRoot);
+		w.pool.wait();
+		manifest_save(w);
+		const auto T1 = steady_clock::now();
+
+		std::cout << "watching " << w.inputRoot.generic_string() << "  (" << w.manifest.size() << " models, checked in " << duration_cast<microseconds>(T1 - T0).count() << " µs)\n";
+	}
+
+	struct sigaction sa {};
+	sa.sa_handler = on_signal;
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGTERM, &sa, nullptr);
+
+	std::set<fs::path> pendingFiles;
+	std::set<fs::path> pendingDirs;
+	auto pendingRescan = false;  // events were lost; check everything
+
+	alignas(inotify_event) char buf[16384];
+
+	while(not g_interrupted)
+	{
+		const auto pending = pendingRescan or not pendingFiles.empty() or not pendingDirs.empty();
+
+		pollfd pfd { fd, POLLIN, 0 };
+		const auto ready = ::poll(&pfd, 1, pending? int(opts.debounceMs): -1);
+		if(ready < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			std::cerr << "poll: " << std::strerror(errno) << '\n';
+			break;
+		}
+
+		if(ready == 0)
+		{
+			// quiet period elapsed; process the whole burst at once
+			const auto T0 = steady_clock::now();
+			const auto numChanges = pendingFiles.size() + pendingDirs.size();
+
+			if(pendingRescan)
+			{
+				std::cout << "event queue overflowed; rescanning " << w.inputRoot.generic_string() << '\n';
+				add_watches(fd, w.inputRoot, watches);
+				remove_missing(w);
+				scan(w, w.inputRoot);
+				// covered by the full scan; checking them again could convert a file twice at once
+				pendingFiles.clear();
+				pendingDirs.clear();
+			}
+			for(const auto &dir: pendingDirs)
+			{
+				add_watches(fd, dir, watches);
+				scan(w, dir);
+			}
+			for(const auto &path: pendingFiles)
+				check(w, path);
+			w.pool.wait();
+			manifest_save(w);
+
+			const auto T1 = steady_clock::now();
+			std::cout << "processed " << numChanges << " change(s)  (" << duration_cast<microseconds>(T1 - T0).count() << " µs)\n";
+
+			pendingFiles.clear();
+			pendingDirs.clear();
+			pendingRescan = false;
+			continue;
+		}
+
+		const auto len = ::read(fd, buf, sizeof(buf));
+		if(len <= 0)
+			continue;
+
+		for(auto offset = 0l; offset < len; )
+		{
+			const auto *event = reinterpret_cast<const inotify_event *>(buf + offset);
+			offset += long(sizeof(inotify_event) + event->len);
+
+			if(event->mask & IN_Q_OVERFLOW)
+			{
+				pendingRescan = true;
+				continue;
+			}
+			if(event->mask & IN_IGNORED)
+			{
+				watches.erase(event->wd);
+				continue;
+			}
+			auto dir = watches.find(event->wd);
+			if(dir == watches.end() or event->len == 0)
+				continue;
+
+			const auto path = dir->second / event->name;
+			if(event->mask & IN_ISDIR)
+			{
+				if(event->mask & (IN_CREATE | IN_MOVED_TO))
+					pendingDirs.insert(path);
+				else // a removed/moved-away directory; drop whatever was under it
+				{
+					const auto prefix = path.lexically_relative(w.inputRoot).generic_string() + "/";
+					std::unique_lock lock(w.manifestMutex);
+					for(const auto &[input, entry]: w.manifest)
+						if(input.compare(0, prefix.size(), prefix) == 0)
+							pendingFiles.insert(w.inputRoot / input);
+				}
+			}
+			else if(is_model(path))
+				pendingFiles.insert(path);
+		}
+	}
+
+	w.pool.wait();
+	manifest_save(w);
+	::close(fd);
+
+	return 0;
+}